@@ -0,0 +1,299 @@
+#!/usr/bin/env python3
+# Compiles one GLSL stage to OpenGL SPIR-V and writes a JSON reflection file next to it.
+#
+# usage: compile_spirv.py <glslangValidator> <input> <output.spv> <output.json> [NAME=VALUE ...]
+#
+# #include "file" is resolved the same way as Shader::preprocess, and defines are injected after #version, so the
+# binary matches the permutation the runtime would have compiled from source.
+
+import json
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+
+def ends_in_comment(line, inside):
+    """Whether a block comment is still open at the end of line, given whether one was at its start."""
+    i = 0
+    while i + 1 < len(line):
+        pair = line[i:i + 2]
+        if inside and pair == "*/":
+            inside = False
+            i += 1
+        elif not inside and pair == "//":
+            break
+        elif not inside and pair == "/*":
+            inside = True
+            i += 1
+        i += 1
+    return inside
+
+
+def preprocess(path, defines, included, root=True):
+    output = []
+    with open(path) as file:
+        lines = file.read().split("\n")
+    if lines and lines[-1] == "":
+        lines.pop()
+    in_comment = False
+    for line in lines:
+        directive = line.lstrip(" \t")
+        # a line starting inside a block comment holds no directives, matching Shader::preprocess
+        commented = in_comment
+        in_comment = ends_in_comment(line, in_comment)
+        if not commented and directive.startswith("#include"):
+            name = directive.split('"')[1]
+            include = os.path.normpath(os.path.join(os.path.dirname(path), name))
+            if include not in included:
+                included.add(include)
+                output.append(preprocess(include, defines, included, False))
+            continue
+        output.append(line + "\n")
+        if root and not commented and directive.startswith("#version"):
+            output.extend(f"#define {name} {value}\n" for name, value in defines)
+    return "".join(output)
+
+
+# SPIR-V opcodes, decorations and storage classes used by the reflection pass
+OP_NAME = 5
+OP_MEMBER_NAME = 6
+OP_TYPE_BOOL = 20
+OP_TYPE_INT = 21
+OP_TYPE_FLOAT = 22
+OP_TYPE_VECTOR = 23
+OP_TYPE_MATRIX = 24
+OP_TYPE_IMAGE = 25
+OP_TYPE_SAMPLED_IMAGE = 27
+OP_TYPE_ARRAY = 28
+OP_TYPE_RUNTIME_ARRAY = 29
+OP_TYPE_STRUCT = 30
+OP_TYPE_POINTER = 32
+OP_CONSTANT = 43
+OP_VARIABLE = 59
+OP_DECORATE = 71
+OP_MEMBER_DECORATE = 72
+
+DECORATION_BLOCK = 2
+DECORATION_BUFFER_BLOCK = 3
+DECORATION_ARRAY_STRIDE = 6
+DECORATION_MATRIX_STRIDE = 7
+DECORATION_BUILTIN = 11
+DECORATION_LOCATION = 30
+DECORATION_BINDING = 33
+DECORATION_OFFSET = 35
+
+STORAGE_UNIFORM_CONSTANT = 0
+STORAGE_INPUT = 1
+STORAGE_UNIFORM = 2
+STORAGE_OUTPUT = 3
+STORAGE_STORAGE_BUFFER = 12
+
+
+def string_literal(words):
+    data = struct.pack(f"<{len(words)}I", *words)
+    return data[: data.index(b"\0")].decode()
+
+
+class Module:
+    def __init__(self, data):
+        words = struct.unpack(f"<{len(data) // 4}I", data)
+        if words[0] != 0x07230203:
+            raise ValueError("not a SPIR-V module")
+
+        self.names = {}
+        self.member_names = {}
+        self.decorations = {}
+        self.member_decorations = {}
+        self.types = {}
+        self.constants = {}
+        self.variables = []
+
+        i = 5
+        while i < len(words):
+            opcode = words[i] & 0xFFFF
+            count = words[i] >> 16
+            operands = words[i + 1 : i + count]
+            i += count
+
+            if opcode == OP_NAME:
+                self.names[operands[0]] = string_literal(operands[1:])
+            elif opcode == OP_MEMBER_NAME:
+                self.member_names[(operands[0], operands[1])] = string_literal(operands[2:])
+            elif opcode == OP_DECORATE:
+                self.decorations.setdefault(operands[0], {})[operands[1]] = operands[2] if len(operands) > 2 else True
+            elif opcode == OP_MEMBER_DECORATE:
+                key = (operands[0], operands[1])
+                self.member_decorations.setdefault(key, {})[operands[2]] = operands[3] if len(operands) > 3 else True
+            elif OP_TYPE_BOOL <= opcode <= OP_TYPE_POINTER:
+                self.types[operands[0]] = (opcode, operands[1:])
+            elif opcode == OP_CONSTANT:
+                self.constants[operands[1]] = operands[2]
+            elif opcode == OP_VARIABLE:
+                self.variables.append((operands[1], operands[0], operands[2]))
+
+    def decoration(self, id, decoration):
+        return self.decorations.get(id, {}).get(decoration)
+
+    def member_decoration(self, id, member, decoration):
+        return self.member_decorations.get((id, member), {}).get(decoration)
+
+    def type_name(self, id):
+        opcode, operands = self.types[id]
+        if opcode == OP_TYPE_BOOL:
+            return "bool"
+        if opcode == OP_TYPE_INT:
+            return "int" if operands[1] else "uint"
+        if opcode == OP_TYPE_FLOAT:
+            return "float"
+        if opcode == OP_TYPE_VECTOR:
+            prefix = {"float": "", "int": "i", "uint": "u", "bool": "b"}[self.type_name(operands[0])]
+            return f"{prefix}vec{operands[1]}"
+        if opcode == OP_TYPE_MATRIX:
+            rows = self.types[operands[0]][1][1]
+            return f"mat{operands[1]}" if rows == operands[1] else f"mat{operands[1]}x{rows}"
+        if opcode == OP_TYPE_SAMPLED_IMAGE:
+            dim, arrayed = self.types[operands[0]][1][1], self.types[operands[0]][1][3]
+            return {1: "sampler2D", 2: "sampler3D", 3: "samplerCube"}[dim] + ("Array" if arrayed else "")
+        if opcode == OP_TYPE_STRUCT:
+            return self.names.get(id, "struct")
+        raise ValueError(f"unsupported type opcode {opcode}")
+
+    def size(self, id):
+        opcode, operands = self.types[id]
+        if opcode in (OP_TYPE_BOOL, OP_TYPE_INT, OP_TYPE_FLOAT):
+            return 4
+        if opcode == OP_TYPE_VECTOR:
+            return 4 * operands[1]
+        if opcode == OP_TYPE_ARRAY:
+            return self.decoration(id, DECORATION_ARRAY_STRIDE) * self.constants[operands[1]]
+        if opcode == OP_TYPE_RUNTIME_ARRAY:
+            return 0
+        if opcode == OP_TYPE_STRUCT:
+            return max((self.member_decoration(id, i, DECORATION_OFFSET) + self.member_size(id, i, member)
+                        for i, member in enumerate(operands)), default=0)
+        raise ValueError(f"cannot size type opcode {opcode}")
+
+    def member_size(self, struct, index, member):
+        if self.types[member][0] == OP_TYPE_MATRIX:
+            return self.member_decoration(struct, index, DECORATION_MATRIX_STRIDE) * self.types[member][1][1]
+        return self.size(member)
+
+    def pointee(self, pointer):
+        return self.types[pointer][1][1]
+
+    def uniforms(self, name, type, location):
+        """Flattens a default-block uniform into the leaf names the GL API would report."""
+        opcode, operands = self.types[type]
+        if opcode == OP_TYPE_STRUCT:
+            result = []
+            for i, member in enumerate(operands):
+                leaves = self.uniforms(f"{name}.{self.member_names[(type, i)]}", member, location)
+                location += sum(leaf["arraySize"] for leaf in leaves)
+                result += leaves
+            return result
+        if opcode == OP_TYPE_ARRAY:
+            length = self.constants[operands[1]]
+            element = self.types[operands[0]][0]
+            if element in (OP_TYPE_STRUCT, OP_TYPE_ARRAY):
+                result = []
+                for i in range(length):
+                    leaves = self.uniforms(f"{name}[{i}]", operands[0], location)
+                    location += sum(leaf["arraySize"] for leaf in leaves)
+                    result += leaves
+                return result
+            return [{"name": f"{name}[0]", "type": self.type_name(operands[0]), "location": location, "arraySize": length}]
+        return [{"name": name, "type": self.type_name(type), "location": location, "arraySize": 1}]
+
+    def block_members(self, struct, prefix, base, storage, top_level):
+        """Flattens block members into leaves named and laid out the way the GL program interface reports them."""
+        result = []
+        for i, member in enumerate(self.types[struct][1]):
+            name = prefix + self.member_names.get((struct, i), "")
+            offset = base + self.member_decoration(struct, i, DECORATION_OFFSET)
+            matrix_stride = self.member_decoration(struct, i, DECORATION_MATRIX_STRIDE) or 0
+            opcode, operands = self.types[member]
+
+            if opcode in (OP_TYPE_ARRAY, OP_TYPE_RUNTIME_ARRAY):
+                element = operands[0]
+                stride = self.decoration(member, DECORATION_ARRAY_STRIDE)
+                length = self.constants[operands[1]] if opcode == OP_TYPE_ARRAY else 0
+                if self.types[element][0] == OP_TYPE_STRUCT:
+                    # storage blocks list only the first element of an outermost array, with its stride
+                    if storage and top_level:
+                        leaves = self.block_members(element, f"{name}[0].", offset, storage, False)
+                        for leaf in leaves:
+                            leaf["topLevelArrayStride"] = stride
+                        result += leaves
+                        continue
+                    for j in range(length):
+                        result += self.block_members(element, f"{name}[{j}].", offset + j * stride, storage, False)
+                    continue
+                result.append({"name": f"{name}[0]", "type": self.type_name(element), "offset": offset,
+                               "arraySize": length, "arrayStride": stride, "matrixStride": matrix_stride,
+                               "topLevelArrayStride": 0})
+            elif opcode == OP_TYPE_STRUCT:
+                result += self.block_members(member, name + ".", offset, storage, top_level)
+            else:
+                result.append({"name": name, "type": self.type_name(member), "offset": offset, "arraySize": 1,
+                               "arrayStride": 0, "matrixStride": matrix_stride, "topLevelArrayStride": 0})
+        return result
+
+    def block(self, variable, type, storage):
+        name = self.names.get(type, "")
+        # members of a block with an instance name are qualified by the block name
+        prefix = name + "." if self.names.get(variable) else ""
+        return {
+            "name": name,
+            "binding": self.decoration(variable, DECORATION_BINDING),
+            "size": self.size(type),
+            "members": self.block_members(type, prefix, 0, storage, True),
+        }
+
+    def reflect(self):
+        result = {"uniforms": [], "uniformBlocks": [], "storageBlocks": [], "inputs": [], "outputs": []}
+        for id, pointer, storage in self.variables:
+            type = self.pointee(pointer)
+            name = self.names.get(id, "")
+            if storage == STORAGE_UNIFORM_CONSTANT:
+                result["uniforms"] += self.uniforms(name, type, self.decoration(id, DECORATION_LOCATION))
+            elif storage == STORAGE_STORAGE_BUFFER or (storage == STORAGE_UNIFORM and self.decoration(type, DECORATION_BUFFER_BLOCK)):
+                result["storageBlocks"].append(self.block(id, type, True))
+            elif storage == STORAGE_UNIFORM:
+                result["uniformBlocks"].append(self.block(id, type, False))
+            elif storage in (STORAGE_INPUT, STORAGE_OUTPUT):
+                # built-ins such as gl_Position are not part of the interface the application sets up
+                if self.decoration(id, DECORATION_BUILTIN) is not None or self.types[type][0] == OP_TYPE_STRUCT:
+                    continue
+                entry = {"name": name, "type": self.type_name(type), "location": self.decoration(id, DECORATION_LOCATION),
+                         "arraySize": 1}
+                result["inputs" if storage == STORAGE_INPUT else "outputs"].append(entry)
+        return result
+
+
+def main():
+    glslang, source, spirv, reflection = sys.argv[1:5]
+    defines = [define.split("=", 1) for define in sys.argv[5:]]
+    stage = os.path.splitext(source)[1][1:]
+
+    path = os.path.normpath(source)
+    with tempfile.NamedTemporaryFile("w", suffix="." + stage) as expanded:
+        expanded.write(preprocess(path, defines, {path}))
+        expanded.flush()
+        result = subprocess.run([glslang, "-G", "-S", stage, "-o", spirv, expanded.name], capture_output=True, text=True)
+    if result.returncode != 0:
+        # glslang reports errors against the expanded file, so name the real source too
+        sys.stderr.write(f"{source}:\n{result.stdout}{result.stderr}")
+        return 1
+
+    with open(spirv, "rb") as file:
+        module = Module(file.read())
+    data = {"stage": stage, "defines": dict(defines), **module.reflect()}
+    with open(reflection, "w") as file:
+        json.dump(data, file, indent=2)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
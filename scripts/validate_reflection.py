@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+# Checks a reflection file written by compile_spirv.py against the GLSL it was compiled from, and touches a stamp
+# file if they agree. Every input, output, uniform and block the reflection lists has to be declared in the source
+# with the same type, location or binding, and a block has to list every member the source declares.
+#
+# usage: validate_reflection.py <input> <reflection.json> <stamp>
+#
+# The source is expanded with the defines the reflection records, the same way compile_spirv.py expanded it.
+
+import json
+import os
+import re
+import sys
+
+from compile_spirv import preprocess
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", " ", text, flags=re.S)
+    return re.sub(r"//[^\n]*", "", text)
+
+
+def apply_conditionals(text, defines):
+    """Keeps the lines an #ifdef/#ifndef/#else/#endif chain selects, without the directives themselves."""
+    defined = set(defines)
+    stack = []
+    output = []
+    for line in text.split("\n"):
+        directive = line.strip().split()
+        keyword = directive[0] if directive else ""
+        active = all(stack)
+        if keyword in ("#ifdef", "#ifndef"):
+            stack.append((directive[1] in defined) == (keyword == "#ifdef"))
+        elif keyword == "#else":
+            stack[-1] = not stack[-1]
+        elif keyword == "#endif":
+            stack.pop()
+        elif active:
+            if keyword == "#define":
+                defined.add(directive[1])
+            elif not keyword.startswith("#"):
+                output.append(line)
+    return "\n".join(output)
+
+
+DECLARATION = re.compile(r"^(\w+)\s+(\w+)\s*(?:\[\s*(\w*)\s*\])?$")
+LAYOUT = re.compile(r"layout\s*\(([^)]*)\)")
+
+
+def parse_members(body):
+    members = []
+    for statement in body.split(";"):
+        statement = " ".join(statement.split())
+        if not statement:
+            continue
+        match = DECLARATION.match(statement)
+        if not match:
+            raise ValueError(f"cannot parse member '{statement}'")
+        type, name, length = match.groups()
+        members.append((type, name, None if length is None else length))
+    return members
+
+
+def layout_qualifiers(text):
+    qualifiers = {}
+    for entry in text.split(","):
+        key, _, value = entry.partition("=")
+        qualifiers[key.strip()] = value.strip()
+    return qualifiers
+
+
+class Source:
+    def __init__(self, text, defines):
+        self.defines = defines
+        self.structs = {}
+        self.interface = {"inputs": [], "outputs": [], "uniforms": [], "uniformBlocks": [], "storageBlocks": []}
+
+        # statements at global scope; function bodies are skipped
+        statement = ""
+        i = 0
+        while i < len(text):
+            char = text[i]
+            i += 1
+            if char == "{" and not self.declaration_head(statement):
+                depth = 1
+                while depth:
+                    depth += {"{": 1, "}": -1}.get(text[i], 0)
+                    i += 1
+                statement = ""
+            elif char == ";" and statement.count("{") == statement.count("}"):
+                self.declare(" ".join(statement.split()))
+                statement = ""
+            else:
+                statement += char
+
+    @staticmethod
+    def declaration_head(statement):
+        # struct and block bodies are declarations; anything else with braces is a function
+        words = LAYOUT.sub("", statement).split()
+        return bool(words) and (words[0] == "struct" or "uniform" in words or "buffer" in words)
+
+    def declare(self, statement):
+        if not statement:
+            return
+        layout = {}
+        match = LAYOUT.search(statement)
+        if match:
+            layout = layout_qualifiers(match.group(1))
+            statement = (statement[: match.start()] + statement[match.end() :]).strip()
+
+        if "{" in statement:
+            head, _, rest = statement.partition("{")
+            body, _, instance = rest.rpartition("}")
+            words = head.split()
+            if words[0] == "struct":
+                self.structs[words[1]] = parse_members(body)
+                return
+            storage = "buffer" in words
+            self.interface["storageBlocks" if storage else "uniformBlocks"].append({
+                "name": words[-1],
+                "binding": int(layout["binding"]) if "binding" in layout else None,
+                "instance": instance.strip(),
+                "members": parse_members(body),
+            })
+            return
+
+        words = statement.split()
+        qualifier = next((word for word in words if word in ("in", "out", "uniform")), None)
+        if qualifier is None:
+            return
+        match = DECLARATION.match(" ".join(words[words.index(qualifier) + 1 :]))
+        if not match:
+            raise ValueError(f"cannot parse declaration '{statement}'")
+        type, name, length = match.groups()
+        location = int(layout["location"]) if "location" in layout else None
+        key = {"in": "inputs", "out": "outputs", "uniform": "uniforms"}[qualifier]
+        self.interface[key].append({"name": name, "type": type, "length": length, "location": location})
+
+    def length(self, value):
+        value = self.defines.get(value, value)
+        return int(value.rstrip("uU"))
+
+    def uniform_leaves(self, name, type, length, location):
+        """The leaf names, types and locations the GL API reports for a default-block uniform."""
+        if length is not None and type in self.structs:
+            leaves = []
+            for i in range(self.length(length)):
+                element = self.uniform_leaves(f"{name}[{i}]", type, None, location)
+                location += sum(leaf[3] for leaf in element)
+                leaves += element
+            return leaves
+        if length is not None:
+            return [(f"{name}[0]", type, location, self.length(length))]
+        if type in self.structs:
+            leaves = []
+            for member_type, member_name, member_length in self.structs[type]:
+                member = self.uniform_leaves(f"{name}.{member_name}", member_type, member_length, location)
+                location += sum(leaf[3] for leaf in member)
+                leaves += member
+            return leaves
+        return [(name, type, location, 1)]
+
+    def block_leaves(self, members, prefix, storage, top_level):
+        """The member names and types the GL program interface reports for a block."""
+        leaves = []
+        for type, name, length in members:
+            name = prefix + name
+            if type in self.structs:
+                if length is None:
+                    leaves += self.block_leaves(self.structs[type], name + ".", storage, top_level)
+                elif storage and top_level:
+                    leaves += self.block_leaves(self.structs[type], f"{name}[0].", storage, False)
+                else:
+                    for i in range(self.length(length)):
+                        leaves += self.block_leaves(self.structs[type], f"{name}[{i}].", storage, False)
+            elif length is not None:
+                leaves.append((f"{name}[0]", type))
+            else:
+                leaves.append((name, type))
+        return leaves
+
+
+def validate(source, reflection):
+    errors = []
+
+    for key in ("inputs", "outputs"):
+        declared = {entry["name"]: entry for entry in source.interface[key]}
+        for entry in reflection[key]:
+            expected = declared.get(entry["name"])
+            if expected is None:
+                errors.append(f"{key[:-1]} {entry['name']} is not declared")
+            elif (entry["type"], entry["location"]) != (expected["type"], expected["location"]):
+                errors.append(f"{key[:-1]} {entry['name']} is {entry['type']} at location {entry['location']}, "
+                              f"declared {expected['type']} at location {expected['location']}")
+
+    declared = {}
+    for entry in source.interface["uniforms"]:
+        for name, type, location, size in source.uniform_leaves(entry["name"], entry["type"], entry["length"],
+                                                                entry["location"]):
+            declared[name] = (type, location, size)
+    for entry in reflection["uniforms"]:
+        expected = declared.get(entry["name"])
+        actual = (entry["type"], entry["location"], entry["arraySize"])
+        if expected is None:
+            errors.append(f"uniform {entry['name']} is not declared")
+        elif actual != expected:
+            errors.append(f"uniform {entry['name']} is {actual[0]}[{actual[2]}] at location {actual[1]}, "
+                          f"declared {expected[0]}[{expected[2]}] at location {expected[1]}")
+
+    for key, storage in (("uniformBlocks", False), ("storageBlocks", True)):
+        blocks = {block["name"]: block for block in source.interface[key]}
+        for block in reflection[key]:
+            expected = blocks.get(block["name"])
+            if expected is None:
+                errors.append(f"block {block['name']} is not declared")
+                continue
+            if block["binding"] != expected["binding"]:
+                errors.append(f"block {block['name']} has binding {block['binding']}, declared {expected['binding']}")
+            prefix = block["name"] + "." if expected["instance"] else ""
+            leaves = dict(source.block_leaves(expected["members"], prefix, storage, True))
+            members = {member["name"]: member["type"] for member in block["members"]}
+            for name in sorted(members.keys() | leaves.keys()):
+                if name not in leaves:
+                    errors.append(f"block {block['name']} member {name} is not declared")
+                elif name not in members:
+                    errors.append(f"block {block['name']} member {name} is missing from the reflection")
+                elif members[name] != leaves[name]:
+                    errors.append(f"block {block['name']} member {name} is {members[name]}, declared {leaves[name]}")
+
+    return errors
+
+
+def main():
+    path, reflection_path, stamp = sys.argv[1:4]
+    with open(reflection_path) as file:
+        reflection = json.load(file)
+    defines = reflection["defines"]
+
+    path = os.path.normpath(path)
+    text = preprocess(path, list(defines.items()), {path})
+    try:
+        source = Source(apply_conditionals(strip_comments(text), defines), defines)
+        errors = validate(source, reflection)
+    except (ValueError, KeyError) as error:
+        errors = [str(error)]
+    if errors:
+        sys.stderr.write("".join(f"{reflection_path}: {error}\n" for error in errors))
+        return 1
+
+    with open(stamp, "w"):
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,7 @@
+// Shared by every program, written once per frame from CameraBlock in camera.hpp
+layout (std140, binding = 0) uniform CameraBlock
+{
+  mat4 projection;
+  mat4 view;
+  vec3 viewPos;
+};
@@ -0,0 +1,138 @@
+// Light and material definitions for lit surfaces. Expects TexCoords to be declared by the includer.
+// Define NO_SPECULAR to drop the specular term, and POINT_LIGHT_COUNT to fix the point light loop's trip count.
+// Define BINDLESS to read the maps as GL_ARB_bindless_texture handles; the includer must enable the extension.
+
+// Every material lives in one storage buffer that draws index into. Its maps are either bindless handles or layers
+// of the texture arrays in materialMaps. A packed material keeps its specular intensity in the diffuse map's alpha
+// channel and has no specular map of its own.
+struct Material {
+#ifdef BINDLESS
+  sampler2D diffuse;
+  sampler2D specular;
+#else
+  // the handle slots stay, so both paths share one buffer layout
+  uvec2 diffuse;
+  uvec2 specular;
+#endif
+  int diffuseLayer;
+  int specularLayer;
+  float shininess;
+  int packedSpecular;
+  // the elements of materialMaps holding the layers
+  int diffuseArray;
+  int specularArray;
+};
+layout (std430, binding = 2) readonly buffer MaterialBlock
+{
+  Material materials[];
+};
+// location 1, after the vertex stage's model matrix
+layout (location = 1) uniform int materialIndex;
+#ifndef BINDLESS
+// every array MaterialLibrary packs maps into, on units 0 to 15 (MaterialLibrary::maxArrays) for the whole frame.
+// Indexing them with materialIndex is dynamically uniform, so draws never rebind. Locations 6 on, after dirLight.
+layout (location = 6, binding = 0) uniform sampler2DArray materialMaps[16];
+#endif
+
+// the material's maps sampled at this fragment, shared by every light
+struct MaterialSample {
+  vec3 diffuse;
+  vec3 specular;
+  float shininess;
+};
+
+MaterialSample SampleMaterial()
+{
+  MaterialSample result;
+#ifdef BINDLESS
+  vec4 diffuse = texture(materials[materialIndex].diffuse, TexCoords);
+#else
+  vec4 diffuse = texture(materialMaps[materials[materialIndex].diffuseArray],
+                         vec3(TexCoords, materials[materialIndex].diffuseLayer));
+#endif
+  result.diffuse = diffuse.rgb;
+  result.specular = vec3(0.0);
+  result.shininess = materials[materialIndex].shininess;
+#ifndef NO_SPECULAR
+  if (materials[materialIndex].packedSpecular != 0)
+    result.specular = vec3(diffuse.a);
+  else
+#ifdef BINDLESS
+    result.specular = texture(materials[materialIndex].specular, TexCoords).rgb;
+#else
+    result.specular = texture(materialMaps[materials[materialIndex].specularArray],
+                              vec3(TexCoords, materials[materialIndex].specularLayer)).rgb;
+#endif
+#endif
+  return result;
+}
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+// locations 2 to 5, one per member
+layout (location = 2) uniform DirLight dirLight;
+
+// attenuation terms are interleaved with the vectors so the std430 layout has no holes
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+layout (std430, binding = 1) buffer PointLightBlock
+{
+  uint pointLightCount;
+  PointLight pointLights[];
+};
+
+vec3 CalcDirLight(DirLight light, MaterialSample material, vec3 normal, vec3 viewDir)
+{
+  vec3 lightDir = normalize(-light.direction);
+  // diffuse shading
+  float diff = max(dot(normal, lightDir), 0.0);
+  // specular shading
+  vec3 reflectDir = reflect(-lightDir, normal);
+  float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+  // combine results
+  vec3 ambient = light.ambient  * material.diffuse;
+  vec3 diffuse = light.diffuse  * diff * material.diffuse;
+#ifdef NO_SPECULAR
+  return (ambient + diffuse);
+#else
+  vec3 specular = light.specular * spec * material.specular;
+  return (ambient + diffuse + specular);
+#endif
+}
+
+vec3 CalcPointLight(PointLight light, MaterialSample material, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+  vec3 lightDir = normalize(light.position - fragPos);
+  // diffuse shading
+  float diff = max(dot(normal, lightDir), 0.0);
+  // specular shading
+  vec3 reflectDir = reflect(-lightDir, normal);
+  float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+  // attenuation
+  float distance = length(light.position - fragPos);
+  float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+  // combine results
+  vec3 ambient = light.ambient  * material.diffuse;
+  vec3 diffuse = light.diffuse  * diff * material.diffuse;
+  ambient *= attenuation;
+  diffuse *= attenuation;
+#ifdef NO_SPECULAR
+  return (ambient + diffuse);
+#else
+  vec3 specular = light.specular * spec * material.specular;
+  specular *= attenuation;
+  return (ambient + diffuse + specular);
+#endif
+}
@@ -1,7 +1,7 @@
-#version 330 core
-out vec4 FragColor;
+#version 430 core
+layout (location = 0) out vec4 FragColor;
 
-uniform vec3 lightColor;
+layout (location = 1) uniform vec3 lightColor;
 
 void main()
 {
@@ -0,0 +1,355 @@
+#include "block_compression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+struct ColorBlock
+{
+  uint16_t color0;
+  uint16_t color1;
+  uint32_t indices;
+  uint32_t error;
+};
+
+uint16_t pack565(const float color[3])
+{
+  auto quantize = [](float value, int32_t max) {
+    return uint16_t(std::lround(std::clamp(value, 0.0f, 255.0f) * max / 255.0f));
+  };
+  return quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31);
+}
+
+void unpack565(uint16_t packed, int32_t color[3])
+{
+  int32_t r = packed >> 11;
+  int32_t g = (packed >> 5) & 63;
+  int32_t b = packed & 31;
+  // replicate the high bits into the low ones, as the hardware does
+  color[0] = r << 3 | r >> 2;
+  color[1] = g << 2 | g >> 4;
+  color[2] = b << 3 | b >> 2;
+}
+
+// the four colors of an opaque BC1 block, in index order
+void colorPalette(uint16_t color0, uint16_t color1, int32_t palette[4][3])
+{
+  unpack565(color0, palette[0]);
+  unpack565(color1, palette[1]);
+  for (int32_t c = 0; c < 3; c++)
+  {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+}
+
+// picks the nearest palette entry for every pixel of a pair of endpoints
+ColorBlock fitColors(const uint8_t* rgba, uint16_t color0, uint16_t color1)
+{
+  // color0 <= color1 selects the three color mode with transparent black, which opaque blocks must avoid
+  if (color0 < color1)
+    std::swap(color0, color1);
+
+  int32_t palette[4][3];
+  colorPalette(color0, color1, palette);
+  // with equal endpoints only index 0 is guaranteed to decode to the endpoint color
+  int32_t entries = color0 == color1 ? 1 : 4;
+
+  ColorBlock block = {color0, color1, 0, 0};
+  for (int32_t i = 0; i < 16; i++)
+  {
+    const uint8_t* pixel = rgba + i * 4;
+    uint32_t bestError = UINT32_MAX;
+    uint32_t bestIndex = 0;
+    for (int32_t index = 0; index < entries; index++)
+    {
+      uint32_t error = 0;
+      for (int32_t c = 0; c < 3; c++)
+      {
+        int32_t difference = pixel[c] - palette[index][c];
+        error += difference * difference;
+      }
+      if (error < bestError)
+      {
+        bestError = error;
+        bestIndex = index;
+      }
+    }
+    block.indices |= bestIndex << (i * 2);
+    block.error += bestError;
+  }
+  return block;
+}
+
+void encodeColors(const uint8_t* rgba, uint8_t* output)
+{
+  // fit a line through the colors along their principal axis
+  float mean[3] = {};
+  for (int32_t i = 0; i < 16; i++)
+    for (int32_t c = 0; c < 3; c++)
+      mean[c] += rgba[i * 4 + c] / 16.0f;
+
+  float covariance[3][3] = {};
+  for (int32_t i = 0; i < 16; i++)
+    for (int32_t a = 0; a < 3; a++)
+      for (int32_t b = 0; b < 3; b++)
+        covariance[a][b] += (rgba[i * 4 + a] - mean[a]) * (rgba[i * 4 + b] - mean[b]);
+
+  float axis[3] = {1.0f, 1.0f, 1.0f};
+  for (int32_t iteration = 0; iteration < 8; iteration++)
+  {
+    float next[3] = {};
+    for (int32_t a = 0; a < 3; a++)
+      for (int32_t b = 0; b < 3; b++)
+        next[a] += covariance[a][b] * axis[b];
+    float scale = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+    // a flat block has no principal axis; any direction works
+    if (scale == 0.0f)
+      break;
+    for (int32_t c = 0; c < 3; c++)
+      axis[c] = next[c] / scale;
+  }
+  float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  for (int32_t c = 0; c < 3; c++)
+    axis[c] /= length;
+
+  float low = 0.0f;
+  float high = 0.0f;
+  for (int32_t i = 0; i < 16; i++)
+  {
+    float t = 0.0f;
+    for (int32_t c = 0; c < 3; c++)
+      t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+    low = std::min(low, t);
+    high = std::max(high, t);
+  }
+  // pull the endpoints in slightly so the interpolated colors land closer to the bulk of the pixels
+  float inset = (high - low) / 16.0f;
+  low += inset;
+  high -= inset;
+
+  float endpoint0[3];
+  float endpoint1[3];
+  for (int32_t c = 0; c < 3; c++)
+  {
+    endpoint0[c] = mean[c] + axis[c] * high;
+    endpoint1[c] = mean[c] + axis[c] * low;
+  }
+  ColorBlock best = fitColors(rgba, pack565(endpoint0), pack565(endpoint1));
+
+  // refine the endpoints by least squares against the chosen indices
+  for (int32_t iteration = 0; iteration < 2 && best.error > 0; iteration++)
+  {
+    constexpr float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[3] = {};
+    float bx[3] = {};
+    for (int32_t i = 0; i < 16; i++)
+    {
+      float w = weights[(best.indices >> (i * 2)) & 3];
+      aa += w * w;
+      ab += w * (1.0f - w);
+      bb += (1.0f - w) * (1.0f - w);
+      for (int32_t c = 0; c < 3; c++)
+      {
+        ax[c] += w * rgba[i * 4 + c];
+        bx[c] += (1.0f - w) * rgba[i * 4 + c];
+      }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+      break;
+    for (int32_t c = 0; c < 3; c++)
+    {
+      endpoint0[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+      endpoint1[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+    }
+    ColorBlock refined = fitColors(rgba, pack565(endpoint0), pack565(endpoint1));
+    if (refined.error >= best.error)
+      break;
+    best = refined;
+  }
+
+  std::memcpy(output, &best.color0, 2);
+  std::memcpy(output + 2, &best.color1, 2);
+  std::memcpy(output + 4, &best.indices, 4);
+}
+
+void decodeColors(const uint8_t* input, uint8_t* rgba, bool opaque)
+{
+  uint16_t color0;
+  uint16_t color1;
+  uint32_t indices;
+  std::memcpy(&color0, input, 2);
+  std::memcpy(&color1, input + 2, 2);
+  std::memcpy(&indices, input + 4, 4);
+
+  int32_t palette[4][3];
+  colorPalette(color0, color1, palette);
+  bool threeColor = !opaque && color0 <= color1;
+  if (threeColor)
+    for (int32_t c = 0; c < 3; c++)
+    {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+
+  for (int32_t i = 0; i < 16; i++)
+  {
+    uint32_t index = (indices >> (i * 2)) & 3;
+    for (int32_t c = 0; c < 3; c++)
+      rgba[i * 4 + c] = palette[index][c];
+    rgba[i * 4 + 3] = threeColor && index == 3 ? 0 : 255;
+  }
+}
+
+// one channel as eight interpolated values between two endpoints, as used for BC3 alpha and both BC5 channels
+void encodeChannel(const uint8_t* rgba, int32_t channel, uint8_t* output)
+{
+  uint8_t low = 255;
+  uint8_t high = 0;
+  for (int32_t i = 0; i < 16; i++)
+  {
+    low = std::min(low, rgba[i * 4 + channel]);
+    high = std::max(high, rgba[i * 4 + channel]);
+  }
+
+  // the first endpoint being larger selects the eight value mode
+  output[0] = high;
+  output[1] = low;
+  int32_t palette[8] = {high, low};
+  for (int32_t i = 1; i < 7; i++)
+    palette[i + 1] = ((7 - i) * high + i * low) / 7;
+
+  uint64_t indices = 0;
+  if (high != low)
+    for (int32_t i = 0; i < 16; i++)
+    {
+      int32_t value = rgba[i * 4 + channel];
+      uint64_t bestIndex = 0;
+      int32_t bestError = INT32_MAX;
+      for (int32_t index = 0; index < 8; index++)
+        if (std::abs(value - palette[index]) < bestError)
+        {
+          bestError = std::abs(value - palette[index]);
+          bestIndex = index;
+        }
+      indices |= bestIndex << (i * 3);
+    }
+  for (int32_t i = 0; i < 6; i++)
+    output[2 + i] = uint8_t(indices >> (i * 8));
+}
+
+void decodeChannel(const uint8_t* input, uint8_t* rgba, int32_t channel)
+{
+  int32_t palette[8] = {input[0], input[1]};
+  if (input[0] > input[1])
+    for (int32_t i = 1; i < 7; i++)
+      palette[i + 1] = ((7 - i) * input[0] + i * input[1]) / 7;
+  else
+  {
+    for (int32_t i = 1; i < 5; i++)
+      palette[i + 1] = ((5 - i) * input[0] + i * input[1]) / 5;
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+  for (int32_t i = 0; i < 6; i++)
+    indices |= uint64_t(input[2 + i]) << (i * 8);
+  for (int32_t i = 0; i < 16; i++)
+    rgba[i * 4 + channel] = palette[(indices >> (i * 3)) & 7];
+}
+}
+
+size_t blockBytes(BlockFormat format)
+{
+  return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+  return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+void encodeBlock(BlockFormat format, const uint8_t* rgba, uint8_t* block)
+{
+  switch (format)
+  {
+  case BlockFormat::BC1:
+    encodeColors(rgba, block);
+    break;
+  case BlockFormat::BC3:
+    encodeChannel(rgba, 3, block);
+    encodeColors(rgba, block + 8);
+    break;
+  case BlockFormat::BC5:
+    encodeChannel(rgba, 0, block);
+    encodeChannel(rgba, 1, block + 8);
+    break;
+  }
+}
+
+void decodeBlock(BlockFormat format, const uint8_t* block, uint8_t* rgba)
+{
+  switch (format)
+  {
+  case BlockFormat::BC1:
+    decodeColors(block, rgba, false);
+    break;
+  case BlockFormat::BC3:
+    decodeColors(block + 8, rgba, true);
+    decodeChannel(block, rgba, 3);
+    break;
+  case BlockFormat::BC5:
+    decodeChannel(block, rgba, 0);
+    decodeChannel(block + 8, rgba, 1);
+    for (int32_t i = 0; i < 16; i++)
+    {
+      rgba[i * 4 + 2] = 0;
+      rgba[i * 4 + 3] = 255;
+    }
+    break;
+  }
+}
+
+std::vector<uint8_t> compressImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+  std::vector<uint8_t> output(compressedSize(format, width, height));
+  uint8_t* block = output.data();
+  uint8_t pixels[16 * 4];
+  for (uint32_t y = 0; y < height; y += 4)
+    for (uint32_t x = 0; x < width; x += 4)
+    {
+      for (uint32_t row = 0; row < 4; row++)
+        for (uint32_t column = 0; column < 4; column++)
+        {
+          uint32_t sourceX = std::min(x + column, width - 1);
+          uint32_t sourceY = std::min(y + row, height - 1);
+          std::memcpy(pixels + (row * 4 + column) * 4, rgba + (size_t(sourceY) * width + sourceX) * 4, 4);
+        }
+      encodeBlock(format, pixels, block);
+      block += blockBytes(format);
+    }
+  return output;
+}
+
+std::vector<uint8_t> decompressImage(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height)
+{
+  std::vector<uint8_t> output(size_t(width) * height * 4);
+  uint8_t pixels[16 * 4];
+  for (uint32_t y = 0; y < height; y += 4)
+    for (uint32_t x = 0; x < width; x += 4)
+    {
+      decodeBlock(format, blocks, pixels);
+      blocks += blockBytes(format);
+      for (uint32_t row = 0; row < 4 && y + row < height; row++)
+        for (uint32_t column = 0; column < 4 && x + column < width; column++)
+          std::memcpy(output.data() + ((size_t(y) + row) * width + x + column) * 4, pixels + (row * 4 + column) * 4, 4);
+    }
+  return output;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Block-compressed formats the texture cooker can encode. Each 4x4 pixel block becomes 8 or 16 bytes.
+enum class BlockFormat
+{
+  // opaque RGB, 4 bits per pixel
+  BC1,
+  // RGB plus interpolated alpha, 8 bits per pixel
+  BC3,
+  // two independent channels (red and green), 8 bits per pixel; meant for normal maps
+  BC5,
+};
+
+size_t blockBytes(BlockFormat format);
+// bytes needed for an image of this size, with partial blocks at the edges rounded up
+size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// Encodes one block from 16 RGBA8 pixels in row-major order
+void encodeBlock(BlockFormat format, const uint8_t* rgba, uint8_t* block);
+// Decodes one block to 16 RGBA8 pixels; used to measure the encoder's error
+void decodeBlock(BlockFormat format, const uint8_t* block, uint8_t* rgba);
+
+// Compresses a whole RGBA8 image. Blocks that overhang the right or bottom edge repeat the edge pixels.
+std::vector<uint8_t> compressImage(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height);
+std::vector<uint8_t> decompressImage(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height);
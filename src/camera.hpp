@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -21,6 +23,21 @@ const float SPEED       =  0.005f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  45.0f;
 
+// Mirrors the std140 CameraBlock uniform block shared by every program
+struct CameraBlock
+{
+  static constexpr uint32_t binding = 0;
+
+  glm::mat4 projection;
+  glm::mat4 view;
+  glm::vec3 position;
+  float padding;
+};
+static_assert(sizeof(CameraBlock) == 144);
+static_assert(offsetof(CameraBlock, projection) == 0);
+static_assert(offsetof(CameraBlock, view) == 64);
+static_assert(offsetof(CameraBlock, position) == 128);
+
 // An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
 class Camera
 {
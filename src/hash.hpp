@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a, used for uniform name lookups and cache keys. Pass a previous result as the seed to hash several strings.
+constexpr uint64_t fnv1a(std::string_view str, uint64_t hash = 0xcbf29ce484222325)
+{
+  for (char c : str)
+  {
+    hash ^= (uint8_t)c;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
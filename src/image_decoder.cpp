@@ -0,0 +1,183 @@
+#include "image_decoder.hpp"
+#include <algorithm>
+#include <cstdlib>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#ifdef HAVE_SPNG
+#include <spng.h>
+#endif
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+namespace
+{
+bool startsWith(std::span<const uint8_t> file, std::span<const uint8_t> signature)
+{
+  return file.size() >= signature.size() && std::equal(signature.begin(), signature.end(), file.begin());
+}
+
+// rewrites pixels with another channel count using stb_image's rules: grey is the weighted sum of red, green and
+// blue, and a missing alpha is opaque
+std::unique_ptr<uint8_t, PixelsDeleter> convert(std::unique_ptr<uint8_t, PixelsDeleter> pixels, size_t count,
+                                                int32_t from, int32_t to)
+{
+  if (from == to)
+    return pixels;
+  std::unique_ptr<uint8_t, PixelsDeleter> converted((uint8_t*)std::malloc(count * to));
+  const uint8_t* source = pixels.get();
+  uint8_t* target = converted.get();
+  for (size_t i = 0; i < count; i++, source += from, target += to)
+  {
+    bool color = from >= 3;
+    uint8_t alpha = from == 2 || from == 4 ? source[from - 1] : 255;
+    if (to <= 2)
+      target[0] = color ? uint8_t((source[0] * 77 + source[1] * 150 + source[2] * 29) >> 8) : source[0];
+    else
+      for (int32_t channel = 0; channel < 3; channel++)
+        target[channel] = color ? source[channel] : source[0];
+    if (to == 2 || to == 4)
+      target[to - 1] = alpha;
+  }
+  return converted;
+}
+
+class StbDecoder : public ImageDecoder
+{
+public:
+  const char* name() const override { return "stb_image"; }
+  bool exact() const override { return true; }
+
+  bool accepts(std::span<const uint8_t>) const override { return true; }
+
+  DecodedImage decode(std::span<const uint8_t> file, int32_t components) const override
+  {
+    DecodedImage image = {0, 0, 0, nullptr};
+    int32_t fileComponents;
+    // stb_image frees with free unless built otherwise, so its pixels can share the deleter
+    image.pixels.reset(stbi_load_from_memory(file.data(), file.size(), &image.width, &image.height, &fileComponents,
+                                             components));
+    image.components = components ? components : fileComponents;
+    return image;
+  }
+};
+
+#ifdef HAVE_SPNG
+// libspng, built against zlib-ng where available for its SIMD inflate
+class SpngDecoder : public ImageDecoder
+{
+public:
+  const char* name() const override { return "libspng"; }
+  bool exact() const override { return true; }
+
+  bool accepts(std::span<const uint8_t> file) const override
+  {
+    static constexpr uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    return startsWith(file, signature);
+  }
+
+  DecodedImage decode(std::span<const uint8_t> file, int32_t components) const override
+  {
+    DecodedImage image = {0, 0, 0, nullptr};
+    std::unique_ptr<spng_ctx, decltype(&spng_ctx_free)> context(spng_ctx_new(0), spng_ctx_free);
+    // stb_image does not verify checksums either
+    spng_set_crc_action(context.get(), SPNG_CRC_USE, SPNG_CRC_USE);
+    spng_set_png_buffer(context.get(), file.data(), file.size());
+    spng_ihdr header;
+    if (spng_get_ihdr(context.get(), &header))
+      return image;
+
+    // like stb_image, a transparency chunk adds an alpha channel
+    spng_trns transparency;
+    bool grey = header.color_type == SPNG_COLOR_TYPE_GRAYSCALE
+                || header.color_type == SPNG_COLOR_TYPE_GRAYSCALE_ALPHA;
+    bool alpha = header.color_type == SPNG_COLOR_TYPE_GRAYSCALE_ALPHA
+                 || header.color_type == SPNG_COLOR_TYPE_TRUECOLOR_ALPHA
+                 || spng_get_trns(context.get(), &transparency) == 0;
+    int32_t fileComponents = (grey ? 1 : 3) + alpha;
+
+    // decoded as RGB or RGBA, then reduced to the channels asked for
+    int32_t decoded = alpha ? 4 : 3;
+    size_t size;
+    int format = alpha ? SPNG_FMT_RGBA8 : SPNG_FMT_RGB8;
+    if (spng_decoded_image_size(context.get(), format, &size))
+      return image;
+    std::unique_ptr<uint8_t, PixelsDeleter> pixels((uint8_t*)std::malloc(size));
+    if (spng_decode_image(context.get(), pixels.get(), size, format, SPNG_DECODE_TRNS))
+      return image;
+
+    image.width = header.width;
+    image.height = header.height;
+    image.components = components ? components : fileComponents;
+    image.pixels = convert(std::move(pixels), size_t(image.width) * image.height, decoded, image.components);
+    return image;
+  }
+};
+#endif
+
+#ifdef HAVE_TURBOJPEG
+// libjpeg-turbo, whose IDCT and color conversion are SIMD. Its rounding differs slightly from stb_image's.
+class TurboJpegDecoder : public ImageDecoder
+{
+public:
+  const char* name() const override { return "libjpeg-turbo"; }
+  // its IDCT and chroma upsampling round differently from stb_image's
+  bool exact() const override { return false; }
+
+  bool accepts(std::span<const uint8_t> file) const override
+  {
+    static constexpr uint8_t signature[] = {0xff, 0xd8, 0xff};
+    return startsWith(file, signature);
+  }
+
+  DecodedImage decode(std::span<const uint8_t> file, int32_t components) const override
+  {
+    DecodedImage image = {0, 0, 0, nullptr};
+    std::unique_ptr<void, decltype(&tjDestroy)> handle(tjInitDecompress(), tjDestroy);
+    int32_t subsampling, colorspace;
+    if (tjDecompressHeader3(handle.get(), file.data(), file.size(), &image.width, &image.height, &subsampling,
+                            &colorspace))
+      return image;
+
+    int32_t decoded = colorspace == TJCS_GRAY ? 1 : 3;
+    size_t size = size_t(image.width) * image.height * decoded;
+    std::unique_ptr<uint8_t, PixelsDeleter> pixels((uint8_t*)std::malloc(size));
+    if (tjDecompress2(handle.get(), file.data(), file.size(), pixels.get(), image.width, 0, image.height,
+                      decoded == 1 ? TJPF_GRAY : TJPF_RGB, 0))
+      return {0, 0, 0, nullptr};
+
+    image.components = components ? components : decoded;
+    image.pixels = convert(std::move(pixels), size_t(image.width) * image.height, decoded, image.components);
+    return image;
+  }
+};
+#endif
+}
+
+void PixelsDeleter::operator()(uint8_t* pixels) const
+{
+  std::free(pixels);
+}
+
+std::vector<std::unique_ptr<ImageDecoder>> availableDecoders()
+{
+  std::vector<std::unique_ptr<ImageDecoder>> decoders;
+#ifdef HAVE_SPNG
+  decoders.push_back(std::make_unique<SpngDecoder>());
+#endif
+#ifdef HAVE_TURBOJPEG
+  decoders.push_back(std::make_unique<TurboJpegDecoder>());
+#endif
+  decoders.push_back(std::make_unique<StbDecoder>());
+  return decoders;
+}
+
+DecodedImage decodeImage(const std::vector<std::unique_ptr<ImageDecoder>>& decoders, std::span<const uint8_t> file,
+                         int32_t components)
+{
+  for (const std::unique_ptr<ImageDecoder>& decoder : decoders)
+    if (decoder->accepts(file))
+      if (DecodedImage image = decoder->decode(file, components); image.pixels)
+        return image;
+  return {0, 0, 0, nullptr};
+}
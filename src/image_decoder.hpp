@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+// Frees decoded pixels; every decoder allocates them with malloc
+struct PixelsDeleter
+{
+  void operator()(uint8_t* pixels) const;
+};
+
+// Tightly packed rows of 8-bit channels, top row first
+struct DecodedImage
+{
+  int32_t width;
+  int32_t height;
+  int32_t components;
+  // null if decoding failed
+  std::unique_ptr<uint8_t, PixelsDeleter> pixels;
+};
+
+// Turns an encoded image file into pixels. stb_image is the reference that reads every format; the optional
+// backends are faster for the formats they accept and produce the same layout, converting channel counts exactly
+// as stb_image does. Decoding is safe from several threads at once.
+class ImageDecoder
+{
+public:
+  virtual ~ImageDecoder() = default;
+
+  virtual const char* name() const = 0;
+  // whether its pixels match stb_image's bit for bit; lossy formats may round differently
+  virtual bool exact() const = 0;
+  // whether this decoder reads the file, judging by its first bytes
+  virtual bool accepts(std::span<const uint8_t> file) const = 0;
+  // decodes to the file's own channel count, or to components (1 to 4) when nonzero
+  virtual DecodedImage decode(std::span<const uint8_t> file, int32_t components = 0) const = 0;
+};
+
+// the decoders built in, accelerated backends first and stb_image last. libjpeg-turbo is not exact, so the application
+// only has it when configured with -Dturbojpeg_textures=enabled; decode_benchmark always has it when it is installed.
+std::vector<std::unique_ptr<ImageDecoder>> availableDecoders();
+// decodes with the first decoder that accepts the file, moving on to the next if it fails, so stb_image reads what
+// a backend does not support
+DecodedImage decodeImage(const std::vector<std::unique_ptr<ImageDecoder>>& decoders, std::span<const uint8_t> file,
+                         int32_t components = 0);
@@ -0,0 +1,329 @@
+#include "json.hpp"
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <stdexcept>
+
+namespace
+{
+const JsonValue nullValue;
+const JsonValue::Array emptyArray;
+const JsonValue::Object emptyObject;
+
+void appendUtf8(std::string& output, uint32_t codepoint)
+{
+  if (codepoint < 0x80)
+    output += char(codepoint);
+  else if (codepoint < 0x800)
+  {
+    output += char(0xC0 | (codepoint >> 6));
+    output += char(0x80 | (codepoint & 0x3F));
+  }
+  else if (codepoint < 0x10000)
+  {
+    output += char(0xE0 | (codepoint >> 12));
+    output += char(0x80 | ((codepoint >> 6) & 0x3F));
+    output += char(0x80 | (codepoint & 0x3F));
+  }
+  else
+  {
+    output += char(0xF0 | (codepoint >> 18));
+    output += char(0x80 | ((codepoint >> 12) & 0x3F));
+    output += char(0x80 | ((codepoint >> 6) & 0x3F));
+    output += char(0x80 | (codepoint & 0x3F));
+  }
+}
+}
+
+class JsonValue::Parser
+{
+public:
+  Parser(std::string_view text) : text(text) {}
+
+  JsonValue document()
+  {
+    JsonValue result = this->parseValue(0);
+    this->skipWhitespace();
+    if (this->position != this->text.size())
+      this->fail("trailing characters");
+    return result;
+  }
+
+private:
+  // deeper documents are almost certainly malformed, and recursing further risks the stack
+  static constexpr uint32_t maxDepth = 256;
+
+  [[noreturn]] void fail(std::string_view message) const
+  {
+    throw std::runtime_error(std::format("JSON parse error at offset {}: {}", this->position, message));
+  }
+
+  void skipWhitespace()
+  {
+    while (this->position < this->text.size())
+    {
+      char c = this->text[this->position];
+      if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        break;
+      this->position++;
+    }
+  }
+
+  char peek()
+  {
+    this->skipWhitespace();
+    if (this->position == this->text.size())
+      this->fail("unexpected end of input");
+    return this->text[this->position];
+  }
+
+  void expect(char c)
+  {
+    if (this->peek() != c)
+      this->fail(std::format("expected '{}'", c));
+    this->position++;
+  }
+
+  void literal(std::string_view word)
+  {
+    if (this->text.substr(this->position, word.size()) != word)
+      this->fail("invalid literal");
+    this->position += word.size();
+  }
+
+  JsonValue parseValue(uint32_t depth)
+  {
+    if (depth > maxDepth)
+      this->fail("nesting too deep");
+
+    JsonValue result;
+    switch (this->peek())
+    {
+    case '{':
+      result.value = this->parseObject(depth);
+      break;
+    case '[':
+      result.value = this->parseArray(depth);
+      break;
+    case '"':
+      result.value = this->parseString();
+      break;
+    case 't':
+      this->literal("true");
+      result.value = true;
+      break;
+    case 'f':
+      this->literal("false");
+      result.value = false;
+      break;
+    case 'n':
+      this->literal("null");
+      break;
+    default:
+      result.value = this->parseNumber();
+      break;
+    }
+    return result;
+  }
+
+  Object parseObject(uint32_t depth)
+  {
+    Object result;
+    this->expect('{');
+    if (this->peek() == '}')
+    {
+      this->position++;
+      return result;
+    }
+    while (true)
+    {
+      if (this->peek() != '"')
+        this->fail("expected object key");
+      std::string key = this->parseString();
+      this->expect(':');
+      result.emplace_back(std::move(key), this->parseValue(depth + 1));
+      if (this->peek() == '}')
+      {
+        this->position++;
+        return result;
+      }
+      this->expect(',');
+    }
+  }
+
+  Array parseArray(uint32_t depth)
+  {
+    Array result;
+    this->expect('[');
+    if (this->peek() == ']')
+    {
+      this->position++;
+      return result;
+    }
+    while (true)
+    {
+      result.push_back(this->parseValue(depth + 1));
+      if (this->peek() == ']')
+      {
+        this->position++;
+        return result;
+      }
+      this->expect(',');
+    }
+  }
+
+  uint32_t parseHex()
+  {
+    uint32_t result = 0;
+    const char* begin = this->text.data() + this->position;
+    if (this->position + 4 > this->text.size() || std::from_chars(begin, begin + 4, result, 16).ptr != begin + 4)
+      this->fail("invalid unicode escape");
+    this->position += 4;
+    return result;
+  }
+
+  std::string parseString()
+  {
+    std::string result;
+    this->position++;
+    while (true)
+    {
+      if (this->position >= this->text.size())
+        this->fail("unterminated string");
+      char c = this->text[this->position++];
+      if (c == '"')
+        return result;
+      if (c != '\\')
+      {
+        result += c;
+        continue;
+      }
+
+      if (this->position >= this->text.size())
+        this->fail("unterminated string");
+      switch (this->text[this->position++])
+      {
+      case '"':
+        result += '"';
+        break;
+      case '\\':
+        result += '\\';
+        break;
+      case '/':
+        result += '/';
+        break;
+      case 'b':
+        result += '\b';
+        break;
+      case 'f':
+        result += '\f';
+        break;
+      case 'n':
+        result += '\n';
+        break;
+      case 'r':
+        result += '\r';
+        break;
+      case 't':
+        result += '\t';
+        break;
+      case 'u':
+      {
+        uint32_t codepoint = this->parseHex();
+        // characters outside the BMP are written as a surrogate pair
+        if (codepoint >= 0xD800 && codepoint < 0xDC00 && this->text.substr(this->position, 2) == "\\u")
+        {
+          this->position += 2;
+          uint32_t low = this->parseHex();
+          codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+        }
+        appendUtf8(result, codepoint);
+        break;
+      }
+      default:
+        this->fail("invalid escape");
+      }
+    }
+  }
+
+  double parseNumber()
+  {
+    double result = 0;
+    const char* begin = this->text.data() + this->position;
+    const char* end = this->text.data() + this->text.size();
+    auto [ptr, error] = std::from_chars(begin, end, result);
+    if (error != std::errc() || ptr == begin)
+      this->fail("invalid value");
+    this->position += ptr - begin;
+    return result;
+  }
+
+  std::string_view text;
+  size_t position = 0;
+};
+
+JsonValue JsonValue::parse(std::string_view text)
+{
+  return Parser(text).document();
+}
+
+bool JsonValue::boolean(bool fallback) const
+{
+  const bool* result = std::get_if<bool>(&this->value);
+  return result ? *result : fallback;
+}
+
+double JsonValue::number(double fallback) const
+{
+  const double* result = std::get_if<double>(&this->value);
+  return result ? *result : fallback;
+}
+
+std::string_view JsonValue::string(std::string_view fallback) const
+{
+  const std::string* result = std::get_if<std::string>(&this->value);
+  return result ? std::string_view(*result) : fallback;
+}
+
+const JsonValue::Array& JsonValue::array() const
+{
+  const Array* result = std::get_if<Array>(&this->value);
+  return result ? *result : emptyArray;
+}
+
+const JsonValue::Object& JsonValue::object() const
+{
+  const Object* result = std::get_if<Object>(&this->value);
+  return result ? *result : emptyObject;
+}
+
+const JsonValue& JsonValue::operator[](std::string_view key) const
+{
+  for (const auto& [name, member] : this->object())
+    if (name == key)
+      return member;
+  return nullValue;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+  const Array& elements = this->array();
+  return index < elements.size() ? elements[index] : nullValue;
+}
+
+bool JsonValue::contains(std::string_view key) const
+{
+  for (const auto& [name, member] : this->object())
+    if (name == key)
+      return true;
+  return false;
+}
+
+size_t JsonValue::size() const
+{
+  if (const Array* elements = std::get_if<Array>(&this->value))
+    return elements->size();
+  if (const Object* members = std::get_if<Object>(&this->value))
+    return members->size();
+  return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// A parsed JSON document. Lookups of missing keys or out-of-range indices return a null value, so chained lookups
+// only need to check the end result.
+class JsonValue
+{
+public:
+  using Array = std::vector<JsonValue>;
+  // members in document order
+  using Object = std::vector<std::pair<std::string, JsonValue>>;
+
+  JsonValue() = default;
+
+  // throws std::runtime_error on malformed input
+  static JsonValue parse(std::string_view text);
+
+  bool isNull() const { return std::holds_alternative<std::nullptr_t>(this->value); }
+  bool isBool() const { return std::holds_alternative<bool>(this->value); }
+  bool isNumber() const { return std::holds_alternative<double>(this->value); }
+  bool isString() const { return std::holds_alternative<std::string>(this->value); }
+  bool isArray() const { return std::holds_alternative<Array>(this->value); }
+  bool isObject() const { return std::holds_alternative<Object>(this->value); }
+
+  // the accessors return the fallback when the value has a different type
+  bool boolean(bool fallback = false) const;
+  double number(double fallback = 0) const;
+  std::string_view string(std::string_view fallback = "") const;
+  const Array& array() const;
+  const Object& object() const;
+
+  const JsonValue& operator[](std::string_view key) const;
+  const JsonValue& operator[](size_t index) const;
+  bool contains(std::string_view key) const;
+  // element count of an array or member count of an object
+  size_t size() const;
+
+private:
+  class Parser;
+
+  std::variant<std::nullptr_t, bool, double, std::string, Array, Object> value;
+};
@@ -0,0 +1,207 @@
+#include "ktx2.hpp"
+#include "block_compression.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+constexpr uint8_t IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Header
+{
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex
+{
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+// data format descriptor color models and channel ids from the Khronos Data Format specification
+constexpr uint8_t MODEL_BC1A = 128;
+constexpr uint8_t MODEL_BC3 = 130;
+constexpr uint8_t MODEL_BC5 = 132;
+constexpr uint8_t CHANNEL_COLOR = 0;
+constexpr uint8_t CHANNEL_GREEN = 1;
+constexpr uint8_t CHANNEL_BC3_ALPHA = 15;
+constexpr uint8_t QUALIFIER_LINEAR = 0x10;
+
+std::optional<BlockFormat> blockFormat(uint32_t format)
+{
+  switch (Ktx2Format(format))
+  {
+  case Ktx2Format::BC1_RGB_UNORM:
+  case Ktx2Format::BC1_RGB_SRGB:
+    return BlockFormat::BC1;
+  case Ktx2Format::BC3_UNORM:
+  case Ktx2Format::BC3_SRGB:
+    return BlockFormat::BC3;
+  case Ktx2Format::BC5_UNORM:
+    return BlockFormat::BC5;
+  }
+  return std::nullopt;
+}
+
+template <typename T>
+void append(std::vector<uint8_t>& output, T value)
+{
+  const uint8_t* bytes = (const uint8_t*)&value;
+  output.insert(output.end(), bytes, bytes + sizeof(T));
+}
+
+// the basic data format descriptor block that KTX2 requires for every format
+std::vector<uint8_t> dataFormatDescriptor(Ktx2Format format)
+{
+  struct Sample
+  {
+    uint16_t bitOffset;
+    uint8_t channel;
+  };
+
+  bool srgb = format == Ktx2Format::BC1_RGB_SRGB || format == Ktx2Format::BC3_SRGB;
+  uint8_t model = MODEL_BC1A;
+  std::vector<Sample> samples = {{0, CHANNEL_COLOR}};
+  if (format == Ktx2Format::BC3_UNORM || format == Ktx2Format::BC3_SRGB)
+  {
+    model = MODEL_BC3;
+    // alpha is never sRGB encoded
+    samples = {{0, uint8_t(CHANNEL_BC3_ALPHA | (srgb ? QUALIFIER_LINEAR : 0))}, {64, CHANNEL_COLOR}};
+  }
+  else if (format == Ktx2Format::BC5_UNORM)
+  {
+    model = MODEL_BC5;
+    samples = {{0, CHANNEL_COLOR}, {64, CHANNEL_GREEN}};
+  }
+
+  std::vector<uint8_t> output;
+  uint16_t blockSize = 24 + 16 * samples.size();
+  append<uint32_t>(output, 4 + blockSize);
+  // vendor 0 (Khronos), descriptor type 0 (basic), version 2
+  append<uint32_t>(output, 0);
+  append<uint16_t>(output, 2);
+  append<uint16_t>(output, blockSize);
+  output.push_back(model);
+  output.push_back(1); // BT.709 primaries
+  output.push_back(srgb ? 2 : 1); // transfer function
+  output.push_back(0); // straight alpha
+  // 4x4x1x1 texel blocks, stored as dimension minus one
+  output.insert(output.end(), {3, 3, 0, 0});
+  uint8_t bytesPlane[8] = {uint8_t(blockBytes(*blockFormat(uint32_t(format))))};
+  output.insert(output.end(), bytesPlane, bytesPlane + 8);
+  for (const Sample& sample : samples)
+  {
+    append<uint16_t>(output, sample.bitOffset);
+    output.push_back(63); // bit length minus one
+    output.push_back(sample.channel);
+    append<uint32_t>(output, 0); // sample position
+    append<uint32_t>(output, 0);
+    append<uint32_t>(output, UINT32_MAX);
+  }
+  return output;
+}
+
+std::vector<uint8_t> keyValueData()
+{
+  constexpr char writer[] = "KTXwriter\0learn-opengl texture_cooker";
+  std::vector<uint8_t> output;
+  append<uint32_t>(output, sizeof(writer));
+  output.insert(output.end(), writer, writer + sizeof(writer));
+  output.resize((output.size() + 3) & ~size_t(3));
+  return output;
+}
+}
+
+bool writeKtx2(const std::filesystem::path& path, Ktx2Format format, uint32_t width, uint32_t height,
+               const std::vector<std::vector<uint8_t>>& levels)
+{
+  std::vector<uint8_t> dfd = dataFormatDescriptor(format);
+  std::vector<uint8_t> kvd = keyValueData();
+
+  Header header = {};
+  std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+  header.vkFormat = uint32_t(format);
+  header.typeSize = 1;
+  header.pixelWidth = width;
+  header.pixelHeight = height;
+  header.faceCount = 1;
+  header.levelCount = levels.size();
+  header.dfdByteOffset = sizeof(Header) + levels.size() * sizeof(LevelIndex);
+  header.dfdByteLength = dfd.size();
+  header.kvdByteOffset = header.dfdByteOffset + dfd.size();
+  header.kvdByteLength = kvd.size();
+
+  // level data is aligned to the block size, which is a multiple of 4
+  size_t alignment = blockBytes(*blockFormat(header.vkFormat));
+  size_t offset = header.kvdByteOffset + kvd.size();
+  std::vector<LevelIndex> index(levels.size());
+  for (size_t level = levels.size(); level-- > 0;)
+  {
+    offset = (offset + alignment - 1) / alignment * alignment;
+    index[level] = {offset, levels[level].size(), levels[level].size()};
+    offset += levels[level].size();
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  file.write((const char*)&header, sizeof(header));
+  file.write((const char*)index.data(), index.size() * sizeof(LevelIndex));
+  file.write((const char*)dfd.data(), dfd.size());
+  file.write((const char*)kvd.data(), kvd.size());
+  size_t written = header.kvdByteOffset + kvd.size();
+  for (size_t level = levels.size(); level-- > 0;)
+  {
+    const char padding[16] = {};
+    file.write(padding, index[level].byteOffset - written);
+    file.write((const char*)levels[level].data(), levels[level].size());
+    written = index[level].byteOffset + levels[level].size();
+  }
+  return bool(file);
+}
+
+std::optional<Ktx2Image> parseKtx2(std::span<const uint8_t> data)
+{
+  Header header;
+  if (data.size() < sizeof(header))
+    return std::nullopt;
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  std::optional<BlockFormat> format = blockFormat(header.vkFormat);
+  if (std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 || !format || header.typeSize != 1
+      || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1
+      || header.faceCount != 1 || header.levelCount == 0 || header.supercompressionScheme != 0)
+    return std::nullopt;
+  if (sizeof(Header) + size_t(header.levelCount) * sizeof(LevelIndex) > data.size())
+    return std::nullopt;
+
+  Ktx2Image image = {Ktx2Format(header.vkFormat), header.pixelWidth, header.pixelHeight, {}};
+  for (uint32_t level = 0; level < header.levelCount; level++)
+  {
+    LevelIndex index;
+    std::memcpy(&index, data.data() + sizeof(Header) + level * sizeof(LevelIndex), sizeof(index));
+    uint32_t width = std::max(header.pixelWidth >> level, 1u);
+    uint32_t height = std::max(header.pixelHeight >> level, 1u);
+    if (index.byteLength != compressedSize(*format, width, height) || index.byteOffset > data.size()
+        || index.byteLength > data.size() - index.byteOffset)
+      return std::nullopt;
+    image.levels.push_back(data.subspan(index.byteOffset, index.byteLength));
+  }
+  return image;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Vulkan format numbers, which KTX2 uses to identify the pixel format
+enum class Ktx2Format : uint32_t
+{
+  BC1_RGB_UNORM = 131,
+  BC1_RGB_SRGB = 132,
+  BC3_UNORM = 137,
+  BC3_SRGB = 138,
+  BC5_UNORM = 141,
+};
+
+// A 2D KTX2 texture whose mip levels point into the parsed file data
+struct Ktx2Image
+{
+  Ktx2Format format;
+  uint32_t width;
+  uint32_t height;
+  // level 0 is the full resolution image
+  std::vector<std::span<const uint8_t>> levels;
+};
+
+// Writes a 2D texture with its mip chain, level 0 first; returns false if the file cannot be written.
+// Levels are stored smallest first, so a reader streaming the file gets usable mips earliest.
+bool writeKtx2(const std::filesystem::path& path, Ktx2Format format, uint32_t width, uint32_t height,
+               const std::vector<std::vector<uint8_t>>& levels);
+// Validates a KTX2 file held in memory; returns nothing if it is malformed or not a supported 2D texture
+std::optional<Ktx2Image> parseKtx2(std::span<const uint8_t> data);
@@ -0,0 +1,97 @@
+#include "light_buffer.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <glad/glad.h>
+
+LightBuffer::LightBuffer()
+{
+  glGenBuffers(1, &this->id);
+}
+
+LightBuffer::~LightBuffer()
+{
+  glDeleteBuffers(1, &this->id);
+}
+
+uint32_t LightBuffer::add(const PointLight& light)
+{
+  this->lights.push_back(light);
+  this->dirty = true;
+  return this->lights.size() - 1;
+}
+
+void LightBuffer::set(uint32_t index, const PointLight& light)
+{
+  if (std::memcmp(&this->lights[index], &light, sizeof(PointLight)) == 0)
+    return;
+  this->lights[index] = light;
+  this->dirty = true;
+}
+
+const PointLight& LightBuffer::operator[](uint32_t index) const
+{
+  return this->lights[index];
+}
+
+uint32_t LightBuffer::size() const
+{
+  return this->lights.size();
+}
+
+std::vector<std::string> LightBuffer::setLayout(const ShaderReflection::Block& block)
+{
+  const ShaderReflection::BlockMember* count = block.findMember("pointLightCount");
+  const ShaderReflection::BlockMember* first = block.findMember("pointLights[0].position");
+  if (!count || !first)
+    return {std::format("Block {} does not declare pointLightCount and pointLights", block.name)};
+
+  // the lights are copied as-is, so each element must match PointLight exactly
+  size_t base = first->offset;
+  std::vector<std::string> problems = validateBlockLayout(block, {
+    {"pointLights[0].position", base + offsetof(PointLight, position)},
+    {"pointLights[0].constant", base + offsetof(PointLight, constant)},
+    {"pointLights[0].ambient", base + offsetof(PointLight, ambient)},
+    {"pointLights[0].linear", base + offsetof(PointLight, linear)},
+    {"pointLights[0].diffuse", base + offsetof(PointLight, diffuse)},
+    {"pointLights[0].quadratic", base + offsetof(PointLight, quadratic)},
+    {"pointLights[0].specular", base + offsetof(PointLight, specular)},
+  });
+  if (first->topLevelArrayStride != sizeof(PointLight))
+    problems.push_back(std::format("Block {} has a light stride of {}, but PointLight is {} bytes", block.name,
+                                   first->topLevelArrayStride, sizeof(PointLight)));
+  if (!problems.empty())
+    return problems;
+
+  if (this->countOffset != size_t(count->offset) || this->arrayOffset != base)
+  {
+    this->countOffset = count->offset;
+    this->arrayOffset = base;
+    // reallocate and rewrite everything at the new offsets
+    this->capacity = 0;
+    this->dirty = true;
+  }
+  return {};
+}
+
+void LightBuffer::upload()
+{
+  if (!this->dirty)
+    return;
+  this->dirty = false;
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->id);
+  if (this->lights.size() > this->capacity || this->capacity == 0)
+  {
+    this->capacity = std::bit_ceil(std::max<size_t>(this->lights.size(), 1));
+    glBufferData(GL_SHADER_STORAGE_BUFFER, this->arrayOffset + this->capacity * sizeof(PointLight), nullptr,
+                 GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->id);
+  }
+
+  uint32_t count = this->lights.size();
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, this->countOffset, sizeof(count), &count);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, this->arrayOffset, this->lights.size() * sizeof(PointLight),
+                  this->lights.data());
+}
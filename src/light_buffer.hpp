@@ -0,0 +1,63 @@
+#pragma once
+#include "shader_reflection.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Mirrors one element of the std430 PointLightBlock array in cube.frag
+struct PointLight
+{
+  glm::vec3 position;
+  float constant;
+  glm::vec3 ambient;
+  float linear;
+  glm::vec3 diffuse;
+  float quadratic;
+  glm::vec3 specular;
+  float padding;
+};
+static_assert(sizeof(PointLight) == 64);
+static_assert(offsetof(PointLight, position) == 0);
+static_assert(offsetof(PointLight, constant) == 12);
+static_assert(offsetof(PointLight, ambient) == 16);
+static_assert(offsetof(PointLight, linear) == 28);
+static_assert(offsetof(PointLight, diffuse) == 32);
+static_assert(offsetof(PointLight, quadratic) == 44);
+static_assert(offsetof(PointLight, specular) == 48);
+
+// A shader storage buffer holding every point light, re-uploaded only after it changes
+class LightBuffer
+{
+public:
+  static constexpr uint32_t binding = 1;
+  // the light count is stored in front of the array, padded to the array's 16 byte alignment; setLayout() replaces
+  // this with the offset a program reports
+  static constexpr size_t headerSize = 16;
+
+  LightBuffer();
+  LightBuffer(const LightBuffer&) = delete;
+  LightBuffer& operator=(const LightBuffer&) = delete;
+  ~LightBuffer();
+
+  uint32_t add(const PointLight& light);
+  void set(uint32_t index, const PointLight& light);
+  const PointLight& operator[](uint32_t index) const;
+  uint32_t size() const;
+
+  // adopts the member offsets a program reports for PointLightBlock. Returns the mismatches with PointLight, in which
+  // case the layout is left unchanged.
+  std::vector<std::string> setLayout(const ShaderReflection::Block& block);
+
+  // writes pending changes to the GPU, growing the buffer if needed
+  void upload();
+
+  uint32_t id;
+private:
+  std::vector<PointLight> lights;
+  size_t capacity = 0;
+  size_t countOffset = 0;
+  size_t arrayOffset = headerSize;
+  bool dirty = true;
+};
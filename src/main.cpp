@@ -1,8 +1,21 @@
 #include "camera.hpp"
+#include "light_buffer.hpp"
+#include "material_library.hpp"
+#include "mesh.hpp"
+#include "mesh_importer.hpp"
 #include "shader.hpp"
+#include "shader_compiler.hpp"
+#include "shader_library.hpp"
+#include "shader_reflection.hpp"
+#include "shader_watcher.hpp"
+#include "texture_cache.hpp"
+#include "texture_loader.hpp"
+#include "texture_residency.hpp"
+#include "uniform_buffer.hpp"
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <format>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -12,53 +25,54 @@
 #include <imgui_impl_opengl3.h>
 #include <iostream>
 #include <SDL.h>
+#include <string_view>
 #include <thread>
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
-float vertices[] = {
-    // positions          // normals           // texture coords
-    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-     0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
-
-    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   1.0f, 1.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,   0.0f, 0.0f,
-
-    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-    -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-    -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-    -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-    -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-     0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
-     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
-     0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
-
-    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-     0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-     0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
-    -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
-    -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
-
-    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
-     0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-     0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
-    -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
-    -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f
+#include <vector>
+
+// the cube as a triangle list, as it was typed in; weldVertices() turns it into 24 shared vertices
+Vertex cubeTriangles[] = {
+  // position, normal, texture coordinates
+  {{-0.5f, -0.5f, -0.5f}, { 0.0f,  0.0f, -1.0f}, {0.0f, 0.0f}},
+  {{ 0.5f, -0.5f, -0.5f}, { 0.0f,  0.0f, -1.0f}, {1.0f, 0.0f}},
+  {{ 0.5f,  0.5f, -0.5f}, { 0.0f,  0.0f, -1.0f}, {1.0f, 1.0f}},
+  {{ 0.5f,  0.5f, -0.5f}, { 0.0f,  0.0f, -1.0f}, {1.0f, 1.0f}},
+  {{-0.5f,  0.5f, -0.5f}, { 0.0f,  0.0f, -1.0f}, {0.0f, 1.0f}},
+  {{-0.5f, -0.5f, -0.5f}, { 0.0f,  0.0f, -1.0f}, {0.0f, 0.0f}},
+
+  {{-0.5f, -0.5f,  0.5f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 0.0f}},
+  {{ 0.5f, -0.5f,  0.5f}, { 0.0f,  0.0f,  1.0f}, {1.0f, 0.0f}},
+  {{ 0.5f,  0.5f,  0.5f}, { 0.0f,  0.0f,  1.0f}, {1.0f, 1.0f}},
+  {{ 0.5f,  0.5f,  0.5f}, { 0.0f,  0.0f,  1.0f}, {1.0f, 1.0f}},
+  {{-0.5f,  0.5f,  0.5f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 1.0f}},
+  {{-0.5f, -0.5f,  0.5f}, { 0.0f,  0.0f,  1.0f}, {0.0f, 0.0f}},
+
+  {{-0.5f,  0.5f,  0.5f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
+  {{-0.5f,  0.5f, -0.5f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 1.0f}},
+  {{-0.5f, -0.5f, -0.5f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}},
+  {{-0.5f, -0.5f, -0.5f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}},
+  {{-0.5f, -0.5f,  0.5f}, {-1.0f,  0.0f,  0.0f}, {0.0f, 0.0f}},
+  {{-0.5f,  0.5f,  0.5f}, {-1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
+
+  {{ 0.5f,  0.5f,  0.5f}, { 1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
+  {{ 0.5f,  0.5f, -0.5f}, { 1.0f,  0.0f,  0.0f}, {1.0f, 1.0f}},
+  {{ 0.5f, -0.5f, -0.5f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}},
+  {{ 0.5f, -0.5f, -0.5f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 1.0f}},
+  {{ 0.5f, -0.5f,  0.5f}, { 1.0f,  0.0f,  0.0f}, {0.0f, 0.0f}},
+  {{ 0.5f,  0.5f,  0.5f}, { 1.0f,  0.0f,  0.0f}, {1.0f, 0.0f}},
+
+  {{-0.5f, -0.5f, -0.5f}, { 0.0f, -1.0f,  0.0f}, {0.0f, 1.0f}},
+  {{ 0.5f, -0.5f, -0.5f}, { 0.0f, -1.0f,  0.0f}, {1.0f, 1.0f}},
+  {{ 0.5f, -0.5f,  0.5f}, { 0.0f, -1.0f,  0.0f}, {1.0f, 0.0f}},
+  {{ 0.5f, -0.5f,  0.5f}, { 0.0f, -1.0f,  0.0f}, {1.0f, 0.0f}},
+  {{-0.5f, -0.5f,  0.5f}, { 0.0f, -1.0f,  0.0f}, {0.0f, 0.0f}},
+  {{-0.5f, -0.5f, -0.5f}, { 0.0f, -1.0f,  0.0f}, {0.0f, 1.0f}},
+
+  {{-0.5f,  0.5f, -0.5f}, { 0.0f,  1.0f,  0.0f}, {0.0f, 1.0f}},
+  {{ 0.5f,  0.5f, -0.5f}, { 0.0f,  1.0f,  0.0f}, {1.0f, 1.0f}},
+  {{ 0.5f,  0.5f,  0.5f}, { 0.0f,  1.0f,  0.0f}, {1.0f, 0.0f}},
+  {{ 0.5f,  0.5f,  0.5f}, { 0.0f,  1.0f,  0.0f}, {1.0f, 0.0f}},
+  {{-0.5f,  0.5f,  0.5f}, { 0.0f,  1.0f,  0.0f}, {0.0f, 0.0f}},
+  {{-0.5f,  0.5f, -0.5f}, { 0.0f,  1.0f,  0.0f}, {0.0f, 1.0f}},
 };
 
 glm::vec3 pointLightPositions[] = {
@@ -81,41 +95,67 @@ glm::vec3 cubePositions[] = {
   glm::vec3(-1.3f,  1.0f, -1.5f)
 };
 
-unsigned int loadTexture(char const * path)
+namespace uniforms
 {
-  unsigned int textureID;
-  glGenTextures(1, &textureID);
+const Uniform<int32_t> materialIndex("materialIndex");
+const Uniform<glm::vec3> dirLightDirection("dirLight.direction");
+const Uniform<glm::vec3> dirLightAmbient("dirLight.ambient");
+const Uniform<glm::vec3> dirLightDiffuse("dirLight.diffuse");
+const Uniform<glm::vec3> dirLightSpecular("dirLight.specular");
+const Uniform<glm::vec3> lightColor("lightColor");
+const Uniform<glm::mat4> model("model");
+}
 
-  int width, height, nrComponents;
-  unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-  if (data)
+PointLight makePointLight(glm::vec3 position, glm::vec3 color)
+{
+  PointLight light = {};
+  light.position = position;
+  light.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+  light.diffuse = color * 0.7f; // darken diffuse light a bit
+  light.specular = color;
+  light.constant = 1.0f;
+  light.linear = 0.045f;
+  light.quadratic = 0.0075f;
+  return light;
+}
+
+// Compares one frame's worth of lighting uniform lookups through the driver against the shader's cached table: the
+// directional light once, then the model matrix and material index of each of the ten cubes
+void benchmarkUniformLookups(const Shader& shader)
+{
+  std::vector<std::string> names = {"dirLight.direction", "dirLight.ambient", "dirLight.diffuse", "dirLight.specular"};
+  for (int i = 0; i < 10; i++)
   {
-    GLenum format = GL_RGB;
-    if (nrComponents == 1)
-      format = GL_RED;
-    else if (nrComponents == 3)
-      format = GL_RGB;
-    else if (nrComponents == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    names.push_back("model");
+    names.push_back("materialIndex");
   }
-  else
-    std::cout << "Texture failed to load at path: " << path << std::endl;
-
-  stbi_image_free(data);
-
-  return textureID;
+  // a name the program lacks would time the miss path, which no frame takes
+  for (const std::string& name : names)
+    if (shader.findUniform(name) < 0)
+      std::cout << std::format("Uniform lookup benchmark: the lighting program has no {}", name) << std::endl;
+
+  using Clock = std::chrono::high_resolution_clock;
+  constexpr int frames = 1000;
+  int32_t sink = 0;
+
+  Clock::time_point start = Clock::now();
+  for (int frame = 0; frame < frames; frame++)
+    for (const std::string& name : names)
+      sink += glGetUniformLocation(shader.id, name.c_str());
+  std::chrono::duration<double, std::micro> driverTime = Clock::now() - start;
+
+  start = Clock::now();
+  for (int frame = 0; frame < frames; frame++)
+    for (const std::string& name : names)
+      sink += shader.findUniform(name);
+  std::chrono::duration<double, std::micro> cachedTime = Clock::now() - start;
+
+  std::cout << std::format("Uniform lookups ({} per frame): driver {:.2f} us/frame, cached {:.2f} us/frame ({})",
+                           names.size(), driverTime.count() / frames, cachedTime.count() / frames, sink)
+            << std::endl;
 }
 
-int main()
+int main(int argc, char** argv)
 {
   SDL_SetHint(SDL_HINT_VIDEODRIVER, "wayland,x11");
   if (SDL_Init(SDL_INIT_EVERYTHING) < 0)
@@ -123,6 +163,10 @@ int main()
 
   SDL_GL_LoadLibrary(nullptr);
   SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+  // shader storage buffers need 4.3
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 
   SDL_Window* window = SDL_CreateWindow("Learn OpenGL", 0, 0, 800, 600,
                                         SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_OPENGL);
@@ -138,49 +182,67 @@ int main()
   ImGui::StyleColorsDark();
 
   ImGui_ImplSDL2_InitForOpenGL(window, context);
-  ImGui_ImplOpenGL3_Init();
+  ImGui_ImplOpenGL3_Init("#version 430 core");
 
   gladLoadGLLoader(SDL_GL_GetProcAddress);
   std::cout << std::format("OpenGL version: {}", (const char*)(glGetString(GL_VERSION))) << std::endl;
 
-  unsigned int VBO, cubeVAO;
-  glGenVertexArrays(1, &cubeVAO);
-  glGenBuffers(1, &VBO);
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-  glBindVertexArray(cubeVAO);
-
-  // position attribute
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(0);
-  // normal vectors
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
-  // texture coordinates
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
+  // the lamps draw the same cube, reading only its positions
+  Mesh cube(weldVertices(cubeTriangles), compactVertexFormat);
+  // an OBJ or glTF model named on the command line is drawn beside the cubes. Imports are cached, so later launches
+  // only map the cached buffers and upload them. --no-bindless uses texture arrays even where bindless textures work.
+  const char* modelPath = nullptr;
+  bool allowBindless = true;
+  for (int i = 1; i < argc; i++)
+    if (std::string_view(argv[i]) == "--no-bindless")
+      allowBindless = false;
+    else
+      modelPath = argv[i];
+  std::unique_ptr<Mesh> importedMesh = modelPath ? loadMesh(modelPath, compactVertexFormat) : nullptr;
 
-  unsigned int lightCubeVAO;
-  glGenVertexArrays(1, &lightCubeVAO);
-  glBindVertexArray(lightCubeVAO);
-
-  // we only need to bind to the VBO, the container's VBO's data already contains the data.
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
-
-  Shader lightingShader("shaders/cube.vert", "shaders/cube.frag");
-  Shader lightCubeShader("shaders/lightsource.vert", "shaders/lightsource.frag");
-
-  unsigned int diffuseMap = loadTexture("assets/container2.png");
-  unsigned int specularMap = loadTexture("assets/container2_specular.png");
+  glm::vec4 lightColor(1.0f);
 
-  lightingShader.use();
-  lightingShader.setInt("material.diffuse", 0);
-  lightingShader.setInt("material.specular", 1);
+  LightBuffer lightBuffer;
+  for (glm::vec3& pos : pointLightPositions)
+    lightBuffer.add(makePointLight(pos, glm::vec3(lightColor)));
+
+  UniformBuffer<CameraBlock> cameraBuffer(CameraBlock::binding);
+
+  // images decode on worker threads while the first frames draw with placeholders; their mips are averaged in linear
+  // light so they do not darken with distance
+  TextureLoader textureLoader({.filter = MipFilter::Box});
+  TextureCache textureCache(textureLoader);
+  // maps drawn small give up their finest levels when textures outgrow this much video memory
+  MaterialLibrary materialLibrary(textureCache, 64 << 20, allowBindless);
+  // the cooker packs the container's specular map into its diffuse map's alpha, so each fragment samples one texture.
+  // The packed image exists only cooked, so drivers without BC3 sample the two source maps instead.
+  uint32_t containerMaterial = TextureLoader::hasCooked("assets/container2_packed.png")
+    ? materialLibrary.addPacked("assets/container2_packed.png", 64.0f)
+    : materialLibrary.add("assets/container2.png", "assets/container2_specular.png", 64.0f);
+
+  // shaders compile in the background while the rest of the setup runs
+  ShaderCompiler shaderCompiler;
+  ShaderLibrary shaderLibrary(shaderCompiler);
+  shaderLibrary.bindUniformBlock("CameraBlock", CameraBlock::binding);
+  shaderLibrary.bindStorageBlock("PointLightBlock", LightBuffer::binding);
+  shaderLibrary.bindStorageBlock("MaterialBlock", MaterialLibrary::binding);
+
+  // the cube program is specialized on the light count, on whether specular maps are sampled and on how materials
+  // reach their textures
+  auto lightingVariant = [&](bool specular) -> Shader&
+  {
+    ShaderDefines defines = {{"POINT_LIGHT_COUNT", std::format("{}u", lightBuffer.size())}};
+    if (!specular)
+      defines.emplace_back("NO_SPECULAR", "1");
+    if (materialLibrary.bindless)
+      defines.emplace_back("BINDLESS", "1");
+    return shaderLibrary.get("shaders/cube.vert", "shaders/cube.frag", defines);
+  };
+  bool useSpecular = true;
+  Shader* lightingShader = &lightingVariant(true);
+  lightingVariant(false);
+  Shader& lightCubeShader = shaderLibrary.get("shaders/lightsource.vert", "shaders/lightsource.frag");
+  ShaderWatcher shaderWatcher("shaders");
 
   glEnable(GL_DEPTH_TEST);
 
@@ -193,7 +255,6 @@ int main()
 
   SDL_SetRelativeMouseMode(SDL_TRUE);
 
-  glm::vec4 lightColor(1.0f);
   glm::vec4 backgroundColor(0.15f);
 
   SDL_Event event;
@@ -289,75 +350,109 @@ int main()
     glClearColor(backgroundColor.x, backgroundColor.y, backgroundColor.z, backgroundColor.a);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glm::mat4 projection = glm::perspective(glm::radians(camera.zoom), float(width) / float(height), 0.1f, 100.0f);
-    glm::mat4 view = camera.getViewMatrix();
-
-    // activate the shader and set uniforms
-    lightingShader.use();
-    // material
-    lightingShader.setFloat("material.shininess", 64.0f);
-    // directional light
-    lightingShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-    lightingShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-    lightingShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-    lightingShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-    // point lights
-    for (int i = 0; i < 4; i++)
-    {
-      std::string prefix = std::format("pointLights[{}]", i);
-      lightingShader.setVec3(prefix + ".position", pointLightPositions[i]);
-      lightingShader.setVec3(prefix + ".ambient",  0.05f, 0.05f, 0.05f);
-      lightingShader.setVec3(prefix + ".diffuse",  lightColor.x * 0.7f, lightColor.y * 0.7f, lightColor.z * 0.7f); // darken diffuse light a bit
-      lightingShader.setVec3(prefix + ".specular", lightColor.x, lightColor.y, lightColor.z);
-      lightingShader.setFloat(prefix + ".constant",  1.0f);
-      lightingShader.setFloat(prefix + ".linear",    0.045f);
-      lightingShader.setFloat(prefix + ".quadratic", 0.0075f);
-    }
+    CameraBlock cameraBlock;
+    cameraBlock.projection = glm::perspective(glm::radians(camera.zoom), float(width) / float(height), 0.1f, 100.0f);
+    cameraBlock.view = camera.getViewMatrix();
+    cameraBlock.position = camera.position;
+    cameraBuffer.update(cameraBlock);
 
-    // camera
-    lightingShader.setVec3("viewPos", camera.position);
+    // rebuild programs whose sources changed on disk; they keep drawing with the old program until the new one links
+    for (const ShaderWatcher::Change& change : shaderWatcher.takeChanges())
+      shaderLibrary.reload(change.path, change.time);
 
-    // world transformation
-    lightingShader.setMat4("projection", projection);
-    lightingShader.setMat4("view", view);
+    textureCache.poll();
+    materialLibrary.update();
 
+    static bool shadersReady = false;
+    if (!shadersReady && shaderCompiler.poll())
+    {
+      shadersReady = true;
+      benchmarkUniformLookups(*lightingShader);
+
+      // check the hand-written vertex and buffer layouts against what the programs declare
+      const ShaderReflection& lighting = lightingShader->reflect();
+      std::vector<std::string> problems = validateVertexArray(cube.vao, lighting);
+      for (std::string& problem : validateVertexArray(cube.vao, lightCubeShader.reflect()))
+        problems.push_back(std::move(problem));
+      if (const ShaderReflection::Block* block = lighting.findUniformBlock("CameraBlock"))
+        for (std::string& problem : validateBlockLayout(*block, {{"projection", offsetof(CameraBlock, projection)},
+                                                                 {"view", offsetof(CameraBlock, view)},
+                                                                 {"viewPos", offsetof(CameraBlock, position)}}))
+          problems.push_back(std::move(problem));
+      if (const ShaderReflection::Block* block = lighting.findStorageBlock("PointLightBlock"))
+        for (std::string& problem : lightBuffer.setLayout(*block))
+          problems.push_back(std::move(problem));
+      if (const ShaderReflection::Block* block = lighting.findStorageBlock("MaterialBlock"))
+        for (std::string& problem : materialLibrary.validate(*block))
+          problems.push_back(std::move(problem));
+      for (const std::string& problem : problems)
+        std::cout << problem << std::endl;
+    }
+
+    // programs that are still compiling are skipped rather than stalling the frame
+    static Clock::duration uniformTime;
+    static uint32_t textureBinds = 0;
     float angle = float(tick) / 1000;
     static bool rotateCube = true;
-    for (unsigned int i = 0; i < 10; i++)
+    if (lightingShader->ready())
     {
-      glm::mat4 model = glm::mat4(1.0f);
-      model = glm::translate(model, cubePositions[i]);
-      if (rotateCube)
-        model = glm::rotate(model, glm::radians(angle * i), glm::vec3(1.0f, 0.3f, 0.5f));
-      lightingShader.setMat4("model", model);
-
-      // bind diffuse map
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, diffuseMap);
-
-      // bind specular map
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, specularMap);
-
-      // render the cube
-      glBindVertexArray(cubeVAO);
-      glDrawArrays(GL_TRIANGLES, 0, 36);
+      Clock::time_point uniformStart = Clock::now();
+
+      // activate the shader and set uniforms
+      lightingShader->use();
+      // directional light
+      lightingShader->set(uniforms::dirLightDirection, glm::vec3(-0.2f, -1.0f, -0.3f));
+      lightingShader->set(uniforms::dirLightAmbient, glm::vec3(0.05f, 0.05f, 0.05f));
+      lightingShader->set(uniforms::dirLightDiffuse, glm::vec3(0.4f, 0.4f, 0.4f));
+      lightingShader->set(uniforms::dirLightSpecular, glm::vec3(0.5f, 0.5f, 0.5f));
+      // point lights
+      lightBuffer.upload();
+
+      uniformTime = Clock::now() - uniformStart;
+
+      // materials are read from a storage buffer by index. Bindless maps need no binding at all; texture arrays are
+      // all bound once, each to the unit the materials name.
+      textureBinds = materialLibrary.bind();
+      for (unsigned int i = 0; i < 10; i++)
+      {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, cubePositions[i]);
+        if (rotateCube)
+          model = glm::rotate(model, glm::radians(angle * i), glm::vec3(1.0f, 0.3f, 0.5f));
+        lightingShader->set(uniforms::model, model * cube.dequantize);
+
+        lightingShader->set(uniforms::materialIndex, int32_t(containerMaterial));
+
+        // how many pixels a face of the unit cube spans when facing the camera at this distance
+        float distance = std::max(glm::length(cubePositions[i] - camera.position), 0.1f);
+        materialLibrary.request(containerMaterial, cameraBlock.projection[1][1] * height / (2.0f * distance));
+
+        // render the cube
+        cube.draw();
+      }
+
+      // leaving out the model's dequantization fits its bounds to the unit cube, whatever its size
+      if (importedMesh)
+      {
+        lightingShader->set(uniforms::model, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 2.0f)));
+        importedMesh->draw();
+      }
     }
 
     // also draw the lamp objects
-    lightCubeShader.use();
-    lightCubeShader.setVec3("lightColor",  lightColor.x, lightColor.y, lightColor.z);
-    lightCubeShader.setMat4("projection", projection);
-    lightCubeShader.setMat4("view", view);
-    for (glm::vec3& pos : pointLightPositions)
+    if (lightCubeShader.ready())
     {
-      glm::mat4 model(1.0f);
-      model = glm::translate(model, pos);
-      model = glm::scale(model, glm::vec3(0.2f));
-      lightCubeShader.setMat4("model", model);
+      lightCubeShader.use();
+      lightCubeShader.set(uniforms::lightColor, glm::vec3(lightColor));
+      for (glm::vec3& pos : pointLightPositions)
+      {
+        glm::mat4 model(1.0f);
+        model = glm::translate(model, pos);
+        model = glm::scale(model, glm::vec3(0.2f));
+        lightCubeShader.set(uniforms::model, model * cube.dequantize);
 
-      glBindVertexArray(lightCubeVAO);
-      glDrawArrays(GL_TRIANGLES, 0, 36);
+        cube.draw();
+      }
     }
 
     // debug GUI
@@ -372,15 +467,68 @@ int main()
     ImGui::SeparatorText("Graphics");
     ImGuiIO &io = ImGui::GetIO();
     ImGui::Text("Render: %.1f FPS (%.3f ms/frame)", io.Framerate, 1000.0f / io.Framerate);
+    ImGui::Text("Lighting uniforms: %.1f us/frame", std::chrono::duration<float, std::micro>(uniformTime).count());
+    ImGui::Text("Uniform uploads: %u issued, %u skipped", Shader::uniformStats.uploaded, Shader::uniformStats.skipped);
+    Shader::uniformStats = {};
+    ImGui::Text("Cube mesh: %u vertices of %u bytes, %u %s-bit indices", cube.vertexCount, cube.format.stride(),
+                cube.indexCount, cube.indexType == GL_UNSIGNED_SHORT ? "16" : "32");
+    ImGui::Text("Quantization error: position %g, normal %g, uv %g", cube.error.position, cube.error.normal,
+                cube.error.texCoords);
+    if (importedMesh)
+      ImGui::Text("Model: %u vertices, %u triangles, %s in %.1f ms", importedMesh->vertexCount,
+                  importedMesh->indexCount / 3, MeshCache::hits ? "mapped from the cache" : "imported",
+                  (MeshCache::loadTime + MeshCache::importTime).count());
+    ImGui::Text("Textures loading: %u", textureLoader.pending());
+    ImGui::Text("Shaders compiling: %zu (%s)", shaderCompiler.pending.size(), shaderCompiler.parallel ? "parallel" : "serial");
     static bool useVsync = true;
     if (ImGui::Checkbox("Use vsync", &useVsync))
       SDL_GL_SetSwapInterval(useVsync ? 1 : 0);
+    ImGui::SeparatorText("Shaders");
+    ImGui::Text("Permutations: %zu", shaderLibrary.shaders.size());
+    for (const std::unique_ptr<Shader>& shader : shaderLibrary.shaders)
+    {
+      if (!shader->error.empty())
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", shader->error.c_str());
+      else if (shader->reloadTime.count() > 0)
+        ImGui::Text("%s: reloaded in %.2f ms", shader->fragmentPath.c_str(), shader->reloadTime.count());
+    }
+    if (ImGui::Checkbox("Specular maps", &useSpecular))
+      lightingShader = &lightingVariant(useSpecular);
+    ImGui::SeparatorText("Textures");
+    ImGui::Text("Resident: %.1f KiB", textureCache.residentBytes() / 1024.0f);
+    for (const std::unique_ptr<TextureCache::Entry>& entry : textureCache.entries)
+      ImGui::Text("%s: %.1f KiB, %u refs", std::filesystem::path(entry->path).filename().c_str(),
+                  entry->residentBytes / 1024.0f, entry->references);
+    ImGui::Text("Materials: %zu (%s), %u texture binds/frame", materialLibrary.materials.size(),
+                materialLibrary.bindless ? "bindless" : "texture arrays", textureBinds);
+    // the first array is the placeholder for maps still loading
+    for (size_t i = 1; i < materialLibrary.arrays.size(); i++)
+    {
+      const MaterialLibrary::Array& array = materialLibrary.arrays[i];
+      ImGui::Text("Array %zu: %ux%u, %u levels from %u, %u/%u layers", i, array.width, array.height, array.levels,
+                  array.base, array.layers, array.capacity);
+    }
+    TextureResidency& residency = materialLibrary.residency;
+    ImGui::Text("Residency: %.1f KiB, peak %.1f KiB", residency.residentBytes() / 1024.0f,
+                residency.peakBytes / 1024.0f);
+    int budgetKiB = residency.budget >> 10;
+    if (ImGui::SliderInt("Budget (KiB)", &budgetKiB, 64, 256 << 10, "%d", ImGuiSliderFlags_Logarithmic))
+      residency.budget = size_t(budgetKiB) << 10;
+    for (uint32_t i = 0; i < residency.textures.size(); i++)
+    {
+      const TextureResidency::Texture& texture = residency.textures[i];
+      ImGui::Text("Texture %u: levels %u-%zu, %.1f KiB%s", i, texture.resident, texture.levelBytes.size() - 1,
+                  residency.bytes(i, texture.resident) / 1024.0f, texture.loading != texture.resident ? ", loading" : "");
+    }
     ImGui::SeparatorText("Simulation");
     ImGui::Text("Tick: %lu", tick);
     ImGui::Checkbox("Pause", &tickPaused);
     ImGui::Checkbox("Rotate cube", &rotateCube);
     ImGui::SeparatorText("Lighting");
-    ImGui::ColorEdit3("Light color", (float*)&lightColor, ImGuiColorEditFlags_NoInputs);
+    ImGui::Text("Point lights: %u", lightBuffer.size());
+    if (ImGui::ColorEdit3("Light color", (float*)&lightColor, ImGuiColorEditFlags_NoInputs))
+      for (uint32_t i = 0; i < lightBuffer.size(); i++)
+        lightBuffer.set(i, makePointLight(lightBuffer[i].position, glm::vec3(lightColor)));
     ImGui::ColorEdit3("Background color", (float*)&backgroundColor, ImGuiColorEditFlags_NoInputs);
     ImGui::End();
 
@@ -0,0 +1,36 @@
+#include "mapped_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+  int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file < 0)
+    return;
+
+  struct stat status;
+  if (fstat(file, &status) == 0 && status.st_size > 0)
+  {
+    void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (address != MAP_FAILED)
+    {
+      this->address = address;
+      this->size = status.st_size;
+    }
+  }
+  // the mapping keeps its own reference to the file
+  close(file);
+}
+
+MappedFile::~MappedFile()
+{
+  if (this->address)
+    munmap(this->address, this->size);
+}
+
+std::span<const uint8_t> MappedFile::data() const
+{
+  return {(const uint8_t*)this->address, this->size};
+}
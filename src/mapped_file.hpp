@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+// A read-only memory mapping of a whole file. Pages are read in by the kernel as they are touched, so large assets
+// are never copied through a read buffer.
+class MappedFile
+{
+public:
+  // check the result with operator bool; an empty or unreadable file maps to nothing
+  MappedFile(const std::filesystem::path& path);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  std::span<const uint8_t> data() const;
+  explicit operator bool() const { return this->address != nullptr; }
+
+private:
+  void* address = nullptr;
+  size_t size = 0;
+};
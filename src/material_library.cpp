@@ -0,0 +1,428 @@
+#include "material_library.hpp"
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <glad/glad.h>
+#include <iostream>
+
+namespace
+{
+constexpr uint32_t initialCapacity = 4;
+constexpr uint8_t grey[] = {128, 128, 128, 255};
+
+void setSampler(GLenum target, const TextureSampler& sampler)
+{
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, sampler.wrapS);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, sampler.wrapT);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+}
+
+// diffuse maps hold sRGB color; specular maps hold intensities, which are filtered as stored
+TextureSampler colorSampler(TextureSampler sampler)
+{
+  sampler.srgb = true;
+  return sampler;
+}
+
+TextureSampler dataSampler(TextureSampler sampler)
+{
+  sampler.srgb = false;
+  return sampler;
+}
+
+// bytes of each level of a 2D texture, finest first
+std::vector<size_t> levelBytes(uint32_t texture, uint32_t levels)
+{
+  std::vector<size_t> bytes;
+  glBindTexture(GL_TEXTURE_2D, texture);
+  for (uint32_t level = 0; level < levels; level++)
+  {
+    int32_t compressed, size;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+    if (compressed)
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+    else
+    {
+      int32_t width, height, bits = 0;
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+      for (GLenum channel : {GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE})
+      {
+        int32_t channelBits;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, channel, &channelBits);
+        bits += channelBits;
+      }
+      size = width * height * bits / 8;
+    }
+    bytes.push_back(size);
+  }
+  return bytes;
+}
+}
+
+MaterialLibrary::MaterialLibrary(TextureCache& cache, size_t budget, bool allowBindless)
+  : bindless(allowBindless && GLAD_GL_ARB_bindless_texture), residency(budget), cache(cache)
+{
+  glGenBuffers(1, &this->buffer);
+
+  if (this->bindless)
+  {
+    glGenTextures(1, &this->placeholder);
+    glBindTexture(GL_TEXTURE_2D, this->placeholder);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    this->placeholderHandle = glGetTextureHandleARB(this->placeholder);
+    glMakeTextureHandleResidentARB(this->placeholderHandle);
+    return;
+  }
+
+  Array placeholder = {0, 1, 1, 1, GL_RGBA8, {}, 1, 1, 0, 0, 0, UINT32_MAX, {}};
+  placeholder.texture = allocate(placeholder);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+  this->arrays.push_back(placeholder);
+}
+
+MaterialLibrary::~MaterialLibrary()
+{
+  // handles must stop being resident before the cache can delete their textures
+  for (const Map& map : this->maps)
+  {
+    if (map.handle)
+      glMakeTextureHandleNonResidentARB(map.handle);
+    if (map.base > 0)
+      glDeleteTextures(1, &map.texture);
+  }
+  if (this->placeholderHandle)
+    glMakeTextureHandleNonResidentARB(this->placeholderHandle);
+  glDeleteTextures(1, &this->placeholder);
+  for (const Array& array : this->arrays)
+    glDeleteTextures(1, &array.texture);
+  glDeleteBuffers(1, &this->buffer);
+}
+
+uint32_t MaterialLibrary::add(const std::filesystem::path& diffuse, const std::filesystem::path& specular,
+                              float shininess, const TextureSampler& sampler)
+{
+  this->materials.push_back({this->map(diffuse, colorSampler(sampler)), this->map(specular, dataSampler(sampler)),
+                             shininess, false});
+  this->dirty = true;
+  return this->materials.size() - 1;
+}
+
+uint32_t MaterialLibrary::addPacked(const std::filesystem::path& diffuse, float shininess,
+                                    const TextureSampler& sampler)
+{
+  // the alpha channel holding the specular intensity is filtered as stored either way
+  uint32_t map = this->map(diffuse, colorSampler(sampler));
+  this->materials.push_back({map, map, shininess, true});
+  this->dirty = true;
+  return this->materials.size() - 1;
+}
+
+void MaterialLibrary::update()
+{
+  for (uint32_t i = 0; i < this->maps.size(); i++)
+  {
+    Map& map = this->maps[i];
+    if (!map.source.loaded() || map.texture == map.source.id())
+      continue;
+    this->dirty = true;
+
+    uint32_t source = map.source.id();
+    if (!map.levels)
+    {
+      int32_t width, height, format, maxLevel;
+      glBindTexture(GL_TEXTURE_2D, source);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+      glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+      glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+      map.width = width;
+      map.height = height;
+      map.levels = std::min<uint32_t>(maxLevel + 1, std::bit_width(uint32_t(std::max(width, height))));
+      map.format = format;
+    }
+
+    // a texture's state is frozen once it has a handle, which is fine now that the loader is done with it
+    if (this->bindless)
+    {
+      if (!map.handle)
+      {
+        this->adopt(map, source, 0);
+        map.residency = this->residency.add(levelBytes(source, map.levels));
+        this->residents.push_back(i);
+        continue;
+      }
+      // the file loaded again to bring back evicted levels, maybe not all of them
+      uint32_t level = this->residency.textures[map.residency].loading;
+      this->adopt(map, level > 0 ? copyLevels(map, source, 0, level) : source, level);
+      this->residency.loaded(map.residency);
+      continue;
+    }
+
+    if (map.layer.array == 0)
+    {
+      // the color space only mattered for building the mips, so diffuse and specular maps can share an array
+      Array* reserved = this->reserve(map.width, map.height, map.levels, map.format, dataSampler(map.sampler),
+                                      levelBytes(source, map.levels));
+      if (!reserved)
+      {
+        std::cout << std::format("No texture unit left for a new array; {} stays on the placeholder",
+                                 map.path.string())
+                  << std::endl;
+        map.source = {};
+        continue;
+      }
+      Array& array = *reserved;
+      for (uint32_t level = array.base; level < array.levels; level++)
+        glCopyImageSubData(source, GL_TEXTURE_2D, level, 0, 0, 0, array.texture, GL_TEXTURE_2D_ARRAY,
+                           level - array.base, 0, 0, array.layers, std::max(map.width >> level, 1u),
+                           std::max(map.height >> level, 1u), 1);
+      map.layer = {uint32_t(&array - this->arrays.data()), array.layers++};
+    }
+    else
+    {
+      // the file loaded again to fill levels brought back into its array
+      Array& array = this->arrays[map.layer.array];
+      for (uint32_t level = array.base; level < array.filled; level++)
+        glCopyImageSubData(source, GL_TEXTURE_2D, level, 0, 0, 0, array.texture, GL_TEXTURE_2D_ARRAY,
+                           level - array.base, 0, 0, map.layer.layer, std::max(map.width >> level, 1u),
+                           std::max(map.height >> level, 1u), 1);
+      if (--array.reloading == 0)
+      {
+        array.filled = array.base;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+        this->residency.loaded(array.residency);
+      }
+    }
+    // the cache deletes the 2D texture unless something else still samples it
+    map.source = {};
+  }
+
+  for (const TextureResidency::Change& change : this->residency.update())
+    this->apply(change);
+  this->upload();
+}
+
+void MaterialLibrary::request(uint32_t material, float screenSize)
+{
+  const Material& entry = this->materials[material];
+  for (uint32_t index : {entry.diffuse, entry.specular})
+  {
+    const Map& map = this->maps[index];
+    uint32_t texture = this->bindless ? map.residency : this->arrays[map.layer.array].residency;
+    if (texture == UINT32_MAX)
+      continue;
+    uint32_t level = TextureResidency::levelForScreenSize(std::max(map.width, map.height), screenSize);
+    this->residency.request(texture, level);
+  }
+}
+
+MaterialLibrary::Layer MaterialLibrary::layer(uint32_t map) const
+{
+  return this->maps[map].layer;
+}
+
+uint32_t MaterialLibrary::bind() const
+{
+  for (uint32_t i = 0; i < this->arrays.size(); i++)
+  {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, this->arrays[i].texture);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  return this->arrays.size();
+}
+
+std::vector<std::string> MaterialLibrary::validate(const ShaderReflection::Block& block) const
+{
+  const ShaderReflection::BlockMember* first = block.findMember("materials[0].diffuse");
+  if (!first)
+    return {std::format("Block {} does not declare materials", block.name)};
+
+  std::vector<std::string> problems = validateBlockLayout(block, {
+    {"materials[0].diffuse", offsetof(GpuMaterial, diffuse)},
+    {"materials[0].specular", offsetof(GpuMaterial, specular)},
+    {"materials[0].diffuseLayer", offsetof(GpuMaterial, diffuseLayer)},
+    {"materials[0].specularLayer", offsetof(GpuMaterial, specularLayer)},
+    {"materials[0].shininess", offsetof(GpuMaterial, shininess)},
+    {"materials[0].packedSpecular", offsetof(GpuMaterial, packedSpecular)},
+    {"materials[0].diffuseArray", offsetof(GpuMaterial, diffuseArray)},
+    {"materials[0].specularArray", offsetof(GpuMaterial, specularArray)},
+  });
+  if (first->topLevelArrayStride != sizeof(GpuMaterial))
+    problems.push_back(std::format("Block {} has a material stride of {}, but GpuMaterial is {} bytes", block.name,
+                                   first->topLevelArrayStride, sizeof(GpuMaterial)));
+  return problems;
+}
+
+void MaterialLibrary::upload()
+{
+  if (!this->dirty)
+    return;
+  this->dirty = false;
+
+  std::vector<GpuMaterial> data;
+  data.reserve(this->materials.size());
+  for (const Material& material : this->materials)
+  {
+    const Map& diffuse = this->maps[material.diffuse];
+    const Map& specular = this->maps[material.specular];
+    data.push_back({0, 0, int32_t(diffuse.layer.layer), int32_t(specular.layer.layer), material.shininess,
+                    material.packed, int32_t(diffuse.layer.array), int32_t(specular.layer.array)});
+    if (this->bindless)
+    {
+      data.back().diffuse = diffuse.handle ? diffuse.handle : this->placeholderHandle;
+      data.back().specular = specular.handle ? specular.handle : this->placeholderHandle;
+    }
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+  if (data.size() > this->capacity || this->capacity == 0)
+  {
+    this->capacity = std::bit_ceil(std::max<size_t>(data.size(), 1));
+    glBufferData(GL_SHADER_STORAGE_BUFFER, this->capacity * sizeof(GpuMaterial), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->buffer);
+  }
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(GpuMaterial), data.data());
+}
+
+uint32_t MaterialLibrary::map(const std::filesystem::path& path, const TextureSampler& sampler)
+{
+  uint64_t key = TextureCache::key(std::filesystem::weakly_canonical(path).string(), sampler);
+  if (auto it = this->mapIndex.find(key); it != this->mapIndex.end())
+    return it->second;
+
+  this->maps.push_back({path, this->cache.get(path, sampler), sampler, {0, 0}, 0, 0, 0, 0, 0, 0, 0, UINT32_MAX});
+  this->mapIndex.emplace(key, this->maps.size() - 1);
+  return this->maps.size() - 1;
+}
+
+void MaterialLibrary::apply(const TextureResidency::Change& change)
+{
+  if (this->bindless)
+  {
+    Map& map = this->maps[this->residents[change.texture]];
+    if (change.level > map.base)
+      this->adopt(map, copyLevels(map, map.texture, map.base, change.level), change.level);
+    else
+      map.source = this->cache.get(map.path, map.sampler);
+    return;
+  }
+
+  uint32_t index = this->residents[change.texture];
+  Array& array = this->arrays[index];
+  if (change.level > array.base)
+  {
+    reallocate(array, change.level, change.level, array.capacity);
+    return;
+  }
+  // the levels still held move into the new storage and every layer's file loads again for the rest
+  reallocate(array, change.level, array.base, array.capacity);
+  for (Map& map : this->maps)
+    if (map.layer.array == index)
+    {
+      map.source = this->cache.get(map.path, map.sampler);
+      array.reloading++;
+    }
+}
+
+void MaterialLibrary::adopt(Map& map, uint32_t texture, uint32_t base)
+{
+  uint64_t handle = glGetTextureHandleARB(texture);
+  glMakeTextureHandleResidentARB(handle);
+  if (map.handle)
+    glMakeTextureHandleNonResidentARB(map.handle);
+  if (map.base > 0)
+    glDeleteTextures(1, &map.texture);
+  map.handle = handle;
+  map.texture = texture;
+  map.base = base;
+  // a copy holds everything still needed from the source
+  if (base > 0)
+    map.source = {};
+  this->dirty = true;
+}
+
+uint32_t MaterialLibrary::copyLevels(const Map& map, uint32_t source, uint32_t base, uint32_t level)
+{
+  uint32_t texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexStorage2D(GL_TEXTURE_2D, map.levels - level, map.format, std::max(map.width >> level, 1u),
+                 std::max(map.height >> level, 1u));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, map.levels - level - 1);
+  setSampler(GL_TEXTURE_2D, map.sampler);
+  for (uint32_t i = level; i < map.levels; i++)
+    glCopyImageSubData(source, GL_TEXTURE_2D, i - base, 0, 0, 0, texture, GL_TEXTURE_2D, i - level, 0, 0, 0,
+                       std::max(map.width >> i, 1u), std::max(map.height >> i, 1u), 1);
+  return texture;
+}
+
+MaterialLibrary::Array* MaterialLibrary::reserve(uint32_t width, uint32_t height, uint32_t levels, int32_t format,
+                                                 const TextureSampler& sampler, const std::vector<size_t>& layerBytes)
+{
+  // the placeholder is never packed into
+  auto it = std::find_if(this->arrays.begin() + 1, this->arrays.end(), [&](const Array& array) {
+    return array.width == width && array.height == height && array.levels == levels && array.format == format
+           && array.sampler == sampler;
+  });
+  if (it == this->arrays.end())
+  {
+    if (this->arrays.size() == maxArrays)
+      return nullptr;
+    Array array = {0, width, height, levels, format, sampler, 0, initialCapacity, 0, 0, 0, 0, layerBytes};
+    array.texture = allocate(array);
+    array.residency = this->residency.add(arrayBytes(array));
+    this->residents.push_back(this->arrays.size());
+    this->arrays.push_back(array);
+    return &this->arrays.back();
+  }
+
+  Array& array = *it;
+  if (array.layers < array.capacity)
+    return &array;
+  reallocate(array, array.base, array.filled, array.capacity * 2);
+  this->residency.resize(array.residency, arrayBytes(array));
+  return &array;
+}
+
+void MaterialLibrary::reallocate(Array& array, uint32_t base, uint32_t filled, uint32_t capacity)
+{
+  // array storage is immutable, so any change means copying every layer into a new one
+  Array resized = array;
+  resized.base = base;
+  resized.filled = filled;
+  resized.capacity = capacity;
+  resized.texture = allocate(resized);
+  for (uint32_t level = std::max(array.base, base); level < array.levels; level++)
+    glCopyImageSubData(array.texture, GL_TEXTURE_2D_ARRAY, level - array.base, 0, 0, 0, resized.texture,
+                       GL_TEXTURE_2D_ARRAY, level - base, 0, 0, 0, std::max(array.width >> level, 1u),
+                       std::max(array.height >> level, 1u), array.layers);
+  glDeleteTextures(1, &array.texture);
+  array = std::move(resized);
+}
+
+uint32_t MaterialLibrary::allocate(const Array& array)
+{
+  uint32_t texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, array.levels - array.base, array.format, std::max(array.width >> array.base, 1u),
+                 std::max(array.height >> array.base, 1u), array.capacity);
+  // levels still being loaded back are not sampled
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array.filled - array.base);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - array.base - 1);
+  setSampler(GL_TEXTURE_2D_ARRAY, array.sampler);
+  return texture;
+}
+
+std::vector<size_t> MaterialLibrary::arrayBytes(const Array& array)
+{
+  std::vector<size_t> bytes;
+  for (size_t layerBytes : array.layerBytes)
+    bytes.push_back(layerBytes * array.capacity);
+  return bytes;
+}
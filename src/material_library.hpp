@@ -0,0 +1,187 @@
+#pragma once
+#include "shader_reflection.hpp"
+#include "texture_cache.hpp"
+#include "texture_loader.hpp"
+#include "texture_residency.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Mirrors one element of the std430 MaterialBlock array in lighting.glsl
+struct GpuMaterial
+{
+  // bindless texture handles, or 0 when the maps are texture array layers
+  uint64_t diffuse;
+  uint64_t specular;
+  int32_t diffuseLayer;
+  int32_t specularLayer;
+  float shininess;
+  // nonzero when the specular intensity is the diffuse map's alpha
+  int32_t packedSpecular;
+  // texture units, and arrays, holding the layers
+  int32_t diffuseArray;
+  int32_t specularArray;
+};
+static_assert(sizeof(GpuMaterial) == 40);
+static_assert(offsetof(GpuMaterial, diffuse) == 0);
+static_assert(offsetof(GpuMaterial, specular) == 8);
+static_assert(offsetof(GpuMaterial, diffuseLayer) == 16);
+static_assert(offsetof(GpuMaterial, specularLayer) == 20);
+static_assert(offsetof(GpuMaterial, shininess) == 24);
+static_assert(offsetof(GpuMaterial, packedSpecular) == 28);
+static_assert(offsetof(GpuMaterial, diffuseArray) == 32);
+static_assert(offsetof(GpuMaterial, specularArray) == 36);
+
+// Keeps every material in a shader storage buffer that draws index into, so switching materials never changes
+// texture bindings.
+//
+// With GL_ARB_bindless_texture each map's texture handle is made resident and stored in the buffer, and nothing is
+// bound at all. Without it, maps are packed into GL_TEXTURE_2D_ARRAY layers, one array per size, format, mip count
+// and sampler state, and the buffer stores array and layer indices. bind() puts every array on its own unit once per
+// frame, so draws never rebind either. Either way maps load through the TextureCache; packed maps release their 2D
+// texture once copied.
+//
+// Video memory is kept within a budget by a TextureResidency, fed by request() with how large each material is drawn.
+// Evicting levels copies what remains into a smaller texture, since storage is immutable; bindless maps are tracked
+// one by one, packed maps an array at a time. Evicted levels come back by loading the files again through the cache.
+class MaterialLibrary
+{
+public:
+  static constexpr uint32_t binding = 2;
+  // arrays, including the placeholder, and so texture units bind() uses; the least a fragment shader is guaranteed.
+  // Maps that would need another array stay on the placeholder.
+  static constexpr uint32_t maxArrays = 16;
+
+  struct Layer
+  {
+    // index into arrays
+    uint32_t array;
+    uint32_t layer;
+  };
+
+  struct Material
+  {
+    // maps, for layer(); the same map when packed
+    uint32_t diffuse;
+    uint32_t specular;
+    float shininess;
+    // whether the diffuse map's alpha is the specular intensity
+    bool packed;
+  };
+
+  struct Array
+  {
+    uint32_t texture;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    int32_t format;
+    TextureSampler sampler;
+    uint32_t layers;
+    uint32_t capacity;
+    // first level in storage; the levels before it are evicted
+    uint32_t base;
+    // first level holding every layer's texels. Levels from base up to it are being loaded back and are not sampled.
+    uint32_t filled;
+    // maps still loading their files again to fill those levels
+    uint32_t reloading;
+    // index into residency, or UINT32_MAX for the placeholder
+    uint32_t residency;
+    // bytes of each level of one layer
+    std::vector<size_t> layerBytes;
+  };
+
+  // creates the placeholder texture, so construct it once there is a GL context. The bindless path is used when
+  // allowed and the driver supports it.
+  MaterialLibrary(TextureCache& cache, size_t budget, bool allowBindless = true);
+  MaterialLibrary(const MaterialLibrary&) = delete;
+  MaterialLibrary& operator=(const MaterialLibrary&) = delete;
+  ~MaterialLibrary();
+
+  // returns the index of a new material; maps already used by another material share its layer. The diffuse map is
+  // loaded as sRGB color and the specular map as data, whatever the sampler's srgb flag.
+  uint32_t add(const std::filesystem::path& diffuse, const std::filesystem::path& specular, float shininess,
+               const TextureSampler& sampler = {});
+  // adds a material whose specular intensity is its diffuse map's alpha, so shading it samples one texture
+  uint32_t addPacked(const std::filesystem::path& diffuse, float shininess, const TextureSampler& sampler = {});
+  // makes maps that have finished loading resident or packs them, evicts or reloads levels to stay within the
+  // budget, then uploads changed materials; call once per frame after TextureCache::poll()
+  void update();
+  // records that a draw this frame covers about this many pixels across with the material, so its maps keep the
+  // levels it needs
+  void request(uint32_t material, float screenSize);
+  // where a map lives; maps still loading sit in layer 0 of array 0, a 1x1 grey placeholder
+  Layer layer(uint32_t map) const;
+  // binds array i to texture unit i for the materialMaps sampler array; call once per frame before drawing, after
+  // update(), which can replace arrays. Returns how many were bound, none on the bindless path.
+  uint32_t bind() const;
+
+  // checks a program's MaterialBlock against GpuMaterial, returning the mismatches
+  std::vector<std::string> validate(const ShaderReflection::Block& block) const;
+
+  // whether maps are bindless handles rather than texture array layers
+  const bool bindless;
+  std::vector<Material> materials;
+  // unused on the bindless path
+  std::vector<Array> arrays;
+  // one texture per array, or per map on the bindless path
+  TextureResidency residency;
+
+private:
+  struct Map
+  {
+    std::filesystem::path path;
+    // released once the image has been copied into its array or its levels were evicted, and loaded again to bring
+    // them back
+    TextureCache::Handle source;
+    TextureSampler sampler;
+    Layer layer;
+    // resident bindless handle, once the image has loaded
+    uint64_t handle;
+    // the texture behind the handle: the source, or a copy of its coarser levels owned by the library
+    uint32_t texture;
+    // first level of the full chain in that texture
+    uint32_t base;
+    // level 0 size, level count and internal format of the full chain
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    int32_t format;
+    // index into residency
+    uint32_t residency;
+  };
+
+  void upload();
+  // moves a resource's first level to the one residency asked for
+  void apply(const TextureResidency::Change& change);
+
+  // points a bindless map at a texture holding its levels from base on, releasing what it used before
+  void adopt(Map& map, uint32_t texture, uint32_t base);
+  // copies a map's levels from level on out of a texture holding them from base on, into a new texture
+  static uint32_t copyLevels(const Map& map, uint32_t source, uint32_t base, uint32_t level);
+
+  uint32_t map(const std::filesystem::path& path, const TextureSampler& sampler);
+  // returns an array with room for one more layer of this shape, creating or growing one as needed, or null if a new
+  // one is needed and there are maxArrays already
+  Array* reserve(uint32_t width, uint32_t height, uint32_t levels, int32_t format, const TextureSampler& sampler,
+                 const std::vector<size_t>& layerBytes);
+  // replaces an array's storage with one of this capacity holding levels from base on, copying what both hold
+  static void reallocate(Array& array, uint32_t base, uint32_t filled, uint32_t capacity);
+  static uint32_t allocate(const Array& array);
+  static std::vector<size_t> arrayBytes(const Array& array);
+
+  TextureCache& cache;
+  std::vector<Map> maps;
+  uint32_t placeholder = 0;
+  uint64_t placeholderHandle = 0;
+  uint32_t buffer = 0;
+  size_t capacity = 0;
+  bool dirty = true;
+  // TextureCache::key -> index into maps
+  std::unordered_map<uint64_t, uint32_t> mapIndex;
+  // residency texture -> index into maps on the bindless path, into arrays otherwise
+  std::vector<uint32_t> residents;
+};
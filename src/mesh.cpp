@@ -0,0 +1,223 @@
+#include "mesh.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+// vertices weld by their bytes, so 0.0 and -0.0 stay apart, which keeps hashing and equality consistent
+uint64_t hashVertex(const Vertex& vertex)
+{
+  uint64_t words[4];
+  std::memcpy(words, &vertex, sizeof(words));
+  uint64_t hash = 0;
+  for (uint64_t word : words)
+    hash = std::rotl(hash ^ word, 29) * 0x9e3779b97f4a7c15;
+  // the low bits pick the slot, so fold the high ones into them
+  return hash ^ (hash >> 32);
+}
+
+bool sameVertex(const Vertex& a, const Vertex& b)
+{
+  return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+}
+
+float largest(glm::vec3 v)
+{
+  return std::max({std::abs(v.x), std::abs(v.y), std::abs(v.z)});
+}
+}
+
+MeshData weldVertices(std::span<const Vertex> triangles)
+{
+  MeshData mesh;
+  mesh.indices.reserve(triangles.size());
+  // open addressing over the welded vertices' indices, kept at most half full so probes stay short. It needs no
+  // allocation per vertex, unlike a node-based map, which matters for meshes of millions of triangles.
+  static_assert(sizeof(Vertex) == 4 * sizeof(uint64_t));
+  constexpr uint32_t EMPTY = UINT32_MAX;
+  size_t mask = std::bit_ceil(std::max<size_t>(triangles.size() * 2, 16)) - 1;
+  std::vector<uint32_t> slots(mask + 1, EMPTY);
+  for (const Vertex& vertex : triangles)
+  {
+    size_t slot = hashVertex(vertex) & mask;
+    while (slots[slot] != EMPTY && !sameVertex(mesh.vertices[slots[slot]], vertex))
+      slot = (slot + 1) & mask;
+    if (slots[slot] == EMPTY)
+    {
+      slots[slot] = mesh.vertices.size();
+      mesh.vertices.push_back(vertex);
+    }
+    mesh.indices.push_back(slots[slot]);
+  }
+  return mesh;
+}
+
+uint32_t VertexFormat::stride() const
+{
+  uint32_t positionBytes = this->position == Position::Float ? 12 : 8;
+  uint32_t normalBytes = this->normal == Normal::Float ? 12 : 4;
+  uint32_t texCoordBytes = this->texCoords == TexCoords::Float ? 8 : 4;
+  return positionBytes + normalBytes + texCoordBytes;
+}
+
+EncodedMesh encodeMesh(const MeshData& data, const VertexFormat& format)
+{
+  EncodedMesh mesh = {{format, uint32_t(data.vertices.size()), uint32_t(data.indices.size()), GL_UNSIGNED_INT,
+                       glm::mat4(1.0f), {}},
+                      {},
+                      {}};
+  QuantizationError& error = mesh.layout.error;
+
+  // 16-bit positions are relative to the centre of the bounds. One scale for every axis keeps the dequantization
+  // uniform, so it leaves normals alone.
+  glm::vec3 offset(0.0f);
+  float scale = 1.0f;
+  if (format.position == VertexFormat::Position::Snorm16 && !data.vertices.empty())
+  {
+    glm::vec3 low = data.vertices[0].position;
+    glm::vec3 high = low;
+    for (const Vertex& vertex : data.vertices)
+    {
+      low = glm::min(low, vertex.position);
+      high = glm::max(high, vertex.position);
+    }
+    offset = (low + high) * 0.5f;
+    scale = largest((high - low) * 0.5f);
+    if (scale == 0.0f)
+      scale = 1.0f;
+    mesh.layout.dequantize = glm::scale(glm::translate(glm::mat4(1.0f), offset), glm::vec3(scale));
+  }
+
+  // each attribute is decoded again the way the vertex fetch will, to measure what the encoding lost
+  uint32_t stride = format.stride();
+  std::vector<uint8_t>& bytes = mesh.vertices;
+  bytes.resize(size_t(stride) * data.vertices.size());
+  for (size_t i = 0; i < data.vertices.size(); i++)
+  {
+    const Vertex& vertex = data.vertices[i];
+    uint8_t* out = bytes.data() + i * stride;
+    if (format.position == VertexFormat::Position::Float)
+    {
+      std::memcpy(out, &vertex.position, sizeof(glm::vec3));
+      out += sizeof(glm::vec3);
+    }
+    else
+    {
+      // the fourth component pads the attribute to 8 bytes
+      uint64_t packed = glm::packSnorm4x16(glm::vec4((vertex.position - offset) / scale, 0.0f));
+      std::memcpy(out, &packed, sizeof(packed));
+      out += sizeof(packed);
+      glm::vec3 decoded = glm::vec3(glm::unpackSnorm4x16(packed)) * scale + offset;
+      error.position = std::max(error.position, largest(decoded - vertex.position));
+    }
+
+    if (format.normal == VertexFormat::Normal::Float)
+    {
+      std::memcpy(out, &vertex.normal, sizeof(glm::vec3));
+      out += sizeof(glm::vec3);
+    }
+    else
+    {
+      uint32_t packed = glm::packSnorm3x10_1x2(glm::vec4(vertex.normal, 0.0f));
+      std::memcpy(out, &packed, sizeof(packed));
+      out += sizeof(packed);
+      glm::vec3 decoded = glm::vec3(glm::unpackSnorm3x10_1x2(packed));
+      error.normal = std::max(error.normal, largest(decoded - vertex.normal));
+    }
+
+    if (format.texCoords == VertexFormat::TexCoords::Float)
+      std::memcpy(out, &vertex.texCoords, sizeof(glm::vec2));
+    else
+    {
+      uint32_t packed = glm::packHalf2x16(vertex.texCoords);
+      std::memcpy(out, &packed, sizeof(packed));
+      glm::vec2 decoded = glm::unpackHalf2x16(packed);
+      error.texCoords = std::max({error.texCoords, std::abs(decoded.x - vertex.texCoords.x),
+                                  std::abs(decoded.y - vertex.texCoords.y)});
+    }
+  }
+
+  if (data.vertices.size() <= UINT16_MAX + 1)
+  {
+    mesh.indices.resize(data.indices.size() * sizeof(uint16_t));
+    for (size_t i = 0; i < data.indices.size(); i++)
+    {
+      uint16_t index = data.indices[i];
+      std::memcpy(mesh.indices.data() + i * sizeof(index), &index, sizeof(index));
+    }
+    mesh.layout.indexType = GL_UNSIGNED_SHORT;
+  }
+  else
+  {
+    mesh.indices.resize(data.indices.size() * sizeof(uint32_t));
+    std::memcpy(mesh.indices.data(), data.indices.data(), mesh.indices.size());
+  }
+  return mesh;
+}
+
+Mesh::Mesh(const MeshData& data, const VertexFormat& format)
+  : Mesh(encodeMesh(data, format))
+{
+}
+
+Mesh::Mesh(const EncodedMesh& mesh)
+  : Mesh(mesh.layout, mesh.vertices, mesh.indices)
+{
+}
+
+Mesh::Mesh(const MeshLayout& layout, std::span<const uint8_t> vertices, std::span<const uint8_t> indices)
+  : vertexCount(layout.vertexCount), indexCount(layout.indexCount), indexType(layout.indexType),
+    format(layout.format), dequantize(layout.dequantize), error(layout.error)
+{
+  glGenVertexArrays(1, &this->vao);
+  glGenBuffers(1, &this->vertexBuffer);
+  glGenBuffers(1, &this->indexBuffer);
+  glBindVertexArray(this->vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+  uint32_t stride = this->format.stride();
+  uintptr_t attributeOffset = 0;
+  auto attribute = [&](uint32_t location, int32_t components, uint32_t type, bool normalized, uint32_t size) {
+    glVertexAttribPointer(location, components, type, normalized, stride, (void*)attributeOffset);
+    glEnableVertexAttribArray(location);
+    attributeOffset += size;
+  };
+  if (this->format.position == VertexFormat::Position::Float)
+    attribute(0, 3, GL_FLOAT, false, 12);
+  else
+    attribute(0, 3, GL_SHORT, true, 8);
+  // packed normals always have four components; the shader ignores the fourth
+  if (this->format.normal == VertexFormat::Normal::Float)
+    attribute(1, 3, GL_FLOAT, false, 12);
+  else
+    attribute(1, 4, GL_INT_2_10_10_10_REV, true, 4);
+  if (this->format.texCoords == VertexFormat::TexCoords::Float)
+    attribute(2, 2, GL_FLOAT, false, 8);
+  else
+    attribute(2, 2, GL_HALF_FLOAT, false, 4);
+
+  // the element buffer binding is part of the vertex array
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), indices.data(), GL_STATIC_DRAW);
+  glBindVertexArray(0);
+}
+
+Mesh::~Mesh()
+{
+  glDeleteVertexArrays(1, &this->vao);
+  glDeleteBuffers(1, &this->vertexBuffer);
+  glDeleteBuffers(1, &this->indexBuffer);
+}
+
+void Mesh::draw() const
+{
+  glBindVertexArray(this->vao);
+  glDrawElements(GL_TRIANGLES, this->indexCount, this->indexType, nullptr);
+}
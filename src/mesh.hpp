@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+// One vertex as the lit shaders read it: position at location 0, normal at 1 and texture coordinates at 2
+struct Vertex
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 texCoords;
+};
+static_assert(sizeof(Vertex) == 32);
+
+// Indexed triangles on the CPU
+struct MeshData
+{
+  std::vector<Vertex> vertices;
+  // three per triangle
+  std::vector<uint32_t> indices;
+};
+
+// merges the bitwise identical vertices of a triangle list, keeping them in order of first use
+MeshData weldVertices(std::span<const Vertex> triangles);
+
+// How a mesh stores each vertex attribute. The vertex fetch turns the smaller encodings back into floats, so shaders
+// read the same inputs whichever is used.
+struct VertexFormat
+{
+  // 16-bit positions are normalized to the mesh's bounds, and Mesh::dequantize maps them back
+  enum class Position { Float, Snorm16 };
+  enum class Normal { Float, Snorm10 };
+  enum class TexCoords { Float, Half };
+
+  Position position = Position::Float;
+  Normal normal = Normal::Float;
+  TexCoords texCoords = TexCoords::Float;
+
+  uint32_t stride() const;
+};
+
+// 16 bytes per vertex instead of Vertex's 32
+constexpr VertexFormat compactVertexFormat = {VertexFormat::Position::Snorm16, VertexFormat::Normal::Snorm10,
+                                              VertexFormat::TexCoords::Half};
+
+// the largest difference between a vertex as built and as the GPU reads it back, per attribute
+struct QuantizationError
+{
+  // in the mesh's own units
+  float position;
+  // per component of the unit normal
+  float normal;
+  float texCoords;
+};
+
+// Describes the contents of a mesh's GPU buffers. It holds no pointers, so caches can store it as is.
+struct MeshLayout
+{
+  VertexFormat format;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  uint32_t indexType;
+  // maps stored positions back into the mesh's own space
+  glm::mat4 dequantize;
+  QuantizationError error;
+};
+
+// A mesh converted to the bytes its vertex and index buffers hold
+struct EncodedMesh
+{
+  MeshLayout layout;
+  std::vector<uint8_t> vertices;
+  std::vector<uint8_t> indices;
+};
+
+// Converts vertices to the requested format. Indices become 16-bit when every vertex can be addressed that way,
+// halving the index buffer, and stay 32-bit otherwise.
+EncodedMesh encodeMesh(const MeshData& data, const VertexFormat& format = {});
+
+// A vertex array with its own vertex and index buffers
+class Mesh
+{
+public:
+  // encodes the mesh and uploads it
+  Mesh(const MeshData& data, const VertexFormat& format = {});
+  // uploads buffers that are already encoded, such as a mapped cache file
+  Mesh(const MeshLayout& layout, std::span<const uint8_t> vertices, std::span<const uint8_t> indices);
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+  ~Mesh();
+
+  // binds the vertex array and draws every triangle
+  void draw() const;
+
+  uint32_t vao = 0;
+  uint32_t vertexBuffer = 0;
+  uint32_t indexBuffer = 0;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  uint32_t indexType;
+  const VertexFormat format;
+  // model matrices must be multiplied by it
+  glm::mat4 dequantize;
+  QuantizationError error;
+
+private:
+  // delegated to by the MeshData constructor, which keeps the encoded bytes alive until the upload
+  Mesh(const EncodedMesh& mesh);
+};
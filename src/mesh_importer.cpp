@@ -0,0 +1,877 @@
+#include "mesh_importer.hpp"
+#include "hash.hpp"
+#include "json.hpp"
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::high_resolution_clock;
+
+// runs task(0) to task(count - 1) spread over up to threads threads, including the calling one
+template <typename Task>
+void parallelFor(uint32_t count, uint32_t threads, const Task& task)
+{
+  std::atomic<uint32_t> next = 0;
+  auto run = [&] {
+    for (uint32_t i = next++; i < count; i = next++)
+      task(i);
+  };
+  std::vector<std::thread> workers;
+  for (uint32_t i = 1; i < std::min(count, threads); i++)
+    workers.emplace_back(run);
+  run();
+  for (std::thread& worker : workers)
+    worker.join();
+}
+
+uint32_t threadCount(uint32_t threads)
+{
+  return threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+glm::vec3 faceNormal(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+{
+  glm::vec3 normal = glm::cross(b - a, c - a);
+  float length = glm::length(normal);
+  return length > 0.0f ? normal / length : glm::vec3(0.0f);
+}
+
+// OBJ
+
+constexpr int32_t NO_INDEX = INT32_MIN;
+// each thread parses at least this much of an OBJ file
+constexpr size_t MIN_OBJ_CHUNK = 256 << 10;
+
+// a face corner's position, texture coordinate and normal indices, zero-based. A chunk cannot resolve negative
+// indices on its own, as they count back from the vertices before them in the file, so they are kept relative to the
+// chunk's first vertex until every chunk's counts are known.
+struct ObjCorner
+{
+  int32_t index[3];
+  // bit per attribute
+  uint32_t relative;
+};
+
+struct ObjChunk
+{
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> texCoords;
+  std::vector<glm::vec3> normals;
+  // three per triangle; polygons are split into fans
+  std::vector<ObjCorner> corners;
+  uint32_t lines = 0;
+  // the first malformed line, counted from the start of the chunk
+  uint32_t errorLine = 0;
+  std::string error;
+};
+
+class ObjLine
+{
+public:
+  ObjLine(const char* begin, const char* end)
+    : cursor(begin), end(end)
+  {
+  }
+
+  // true at the end of the line or at a comment
+  bool atEnd()
+  {
+    this->skipSpaces();
+    return this->cursor == this->end || *this->cursor == '#';
+  }
+
+  std::string_view keyword()
+  {
+    this->skipSpaces();
+    const char* begin = this->cursor;
+    while (this->cursor < this->end && !isSpace(*this->cursor))
+      this->cursor++;
+    return {begin, size_t(this->cursor - begin)};
+  }
+
+  bool number(float& value)
+  {
+    this->skipSpaces();
+    if (this->cursor < this->end && *this->cursor == '+')
+      this->cursor++;
+    auto [next, error] = std::from_chars(this->cursor, this->end, value);
+    this->cursor = next;
+    return error == std::errc();
+  }
+
+  // reads a face corner such as 1, 1/2, 1//3 or 1/2/3, resolving it against the chunk's counts so far
+  bool corner(const ObjChunk& chunk, ObjCorner& corner)
+  {
+    const size_t counts[3] = {chunk.positions.size(), chunk.texCoords.size(), chunk.normals.size()};
+    corner = {{NO_INDEX, NO_INDEX, NO_INDEX}, 0};
+    for (uint32_t attribute = 0; attribute < 3; attribute++)
+    {
+      if (attribute > 0)
+      {
+        if (this->cursor == this->end || *this->cursor != '/')
+          break;
+        this->cursor++;
+        // an empty texture coordinate index
+        if (attribute == 1 && this->cursor < this->end && *this->cursor == '/')
+          continue;
+      }
+      int32_t value;
+      auto [next, error] = std::from_chars(this->cursor, this->end, value);
+      if (error != std::errc() || value == 0)
+        return false;
+      this->cursor = next;
+      if (value > 0)
+        corner.index[attribute] = value - 1;
+      else
+      {
+        corner.index[attribute] = int32_t(counts[attribute]) + value;
+        corner.relative |= 1 << attribute;
+      }
+    }
+    return this->cursor == this->end || isSpace(*this->cursor);
+  }
+
+private:
+  static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+  void skipSpaces()
+  {
+    while (this->cursor < this->end && isSpace(*this->cursor))
+      this->cursor++;
+  }
+
+  const char* cursor;
+  const char* end;
+};
+
+// parses one line into the chunk; returns false if it is malformed. Statements other than vertices and faces, such
+// as groups, materials and lines, are skipped.
+bool parseObjLine(ObjLine line, ObjChunk& chunk)
+{
+  std::string_view keyword = line.keyword();
+  if (keyword == "v")
+  {
+    glm::vec3 position;
+    bool valid = line.number(position.x) && line.number(position.y) && line.number(position.z);
+    chunk.positions.push_back(position);
+    return valid;
+  }
+  if (keyword == "vt")
+  {
+    // the second coordinate is optional
+    glm::vec2 texCoords(0.0f);
+    bool valid = line.number(texCoords.x) && (line.atEnd() || line.number(texCoords.y));
+    chunk.texCoords.push_back(texCoords);
+    return valid;
+  }
+  if (keyword == "vn")
+  {
+    glm::vec3 normal;
+    bool valid = line.number(normal.x) && line.number(normal.y) && line.number(normal.z);
+    chunk.normals.push_back(normal);
+    return valid;
+  }
+  if (keyword == "f")
+  {
+    ObjCorner first = {}, previous = {}, corner = {};
+    uint32_t count = 0;
+    for (; !line.atEnd(); count++)
+    {
+      if (!line.corner(chunk, corner))
+        return false;
+      if (count == 0)
+        first = corner;
+      else if (count >= 2)
+        chunk.corners.insert(chunk.corners.end(), {first, previous, corner});
+      previous = corner;
+    }
+    return count >= 3;
+  }
+  return true;
+}
+
+void parseObjChunk(std::string_view text, ObjChunk& chunk)
+{
+  const char* cursor = text.data();
+  const char* end = text.data() + text.size();
+  while (cursor < end)
+  {
+    const char* lineEnd = (const char*)std::memchr(cursor, '\n', end - cursor);
+    if (!lineEnd)
+      lineEnd = end;
+    chunk.lines++;
+    if (!parseObjLine(ObjLine(cursor, lineEnd), chunk) && chunk.error.empty())
+    {
+      chunk.errorLine = chunk.lines;
+      chunk.error = std::string(cursor, lineEnd);
+    }
+    cursor = lineEnd == end ? end : lineEnd + 1;
+  }
+}
+
+std::optional<MeshData> importObj(const std::filesystem::path& path, std::string_view text, uint32_t threads)
+{
+  // chunks start after a line break, so no line is split between two of them
+  uint32_t chunkCount = std::clamp<size_t>(text.size() / MIN_OBJ_CHUNK, 1, threads);
+  std::vector<size_t> starts = {0};
+  for (uint32_t i = 1; i < chunkCount; i++)
+  {
+    size_t start = text.find('\n', std::max(text.size() * i / chunkCount, starts.back()));
+    starts.push_back(start == std::string_view::npos ? text.size() : start + 1);
+  }
+  starts.push_back(text.size());
+
+  std::vector<ObjChunk> chunks(chunkCount);
+  parallelFor(chunkCount, threads, [&](uint32_t i) {
+    parseObjChunk(text.substr(starts[i], starts[i + 1] - starts[i]), chunks[i]);
+  });
+
+  // where each chunk's vertices and triangles land in the whole file's
+  struct Offsets
+  {
+    size_t counts[3];
+    size_t corners;
+  };
+  std::vector<Offsets> offsets(chunkCount + 1, {{0, 0, 0}, 0});
+  uint32_t line = 0;
+  for (uint32_t i = 0; i < chunkCount; i++)
+  {
+    const ObjChunk& chunk = chunks[i];
+    if (!chunk.error.empty())
+    {
+      std::cout << std::format("{}:{}: malformed statement: {}", path.string(), line + chunk.errorLine, chunk.error)
+                << std::endl;
+      return std::nullopt;
+    }
+    line += chunk.lines;
+    offsets[i + 1] = {{offsets[i].counts[0] + chunk.positions.size(), offsets[i].counts[1] + chunk.texCoords.size(),
+                       offsets[i].counts[2] + chunk.normals.size()},
+                      offsets[i].corners + chunk.corners.size()};
+  }
+  const Offsets& total = offsets.back();
+  if (total.corners == 0)
+  {
+    std::cout << std::format("{} has no faces", path.string()) << std::endl;
+    return std::nullopt;
+  }
+
+  std::vector<glm::vec3> positions(total.counts[0]);
+  std::vector<glm::vec2> texCoords(total.counts[1]);
+  std::vector<glm::vec3> normals(total.counts[2]);
+  std::vector<Vertex> triangles(total.corners);
+  std::atomic<bool> outOfRange = false;
+  parallelFor(chunkCount, threads, [&](uint32_t i) {
+    const ObjChunk& chunk = chunks[i];
+    std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + offsets[i].counts[0]);
+    std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + offsets[i].counts[1]);
+    std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + offsets[i].counts[2]);
+  });
+  parallelFor(chunkCount, threads, [&](uint32_t i) {
+    const ObjChunk& chunk = chunks[i];
+    // the index into the whole file's attribute, or -1 if the corner has none or it is out of range
+    auto resolve = [&](const ObjCorner& corner, uint32_t attribute) -> int64_t {
+      int64_t index = corner.index[attribute];
+      if (index == NO_INDEX)
+        return -1;
+      if (corner.relative & (1 << attribute))
+        index += offsets[i].counts[attribute];
+      if (index < 0 || size_t(index) >= total.counts[attribute])
+      {
+        outOfRange = true;
+        return -1;
+      }
+      return index;
+    };
+
+    Vertex* out = triangles.data() + offsets[i].corners;
+    for (size_t corner = 0; corner < chunk.corners.size(); corner += 3, out += 3)
+    {
+      bool smooth = true;
+      for (uint32_t j = 0; j < 3; j++)
+      {
+        const ObjCorner& source = chunk.corners[corner + j];
+        int64_t position = resolve(source, 0);
+        int64_t texCoord = resolve(source, 1);
+        int64_t normal = resolve(source, 2);
+        out[j].position = position >= 0 ? positions[position] : glm::vec3(0.0f);
+        out[j].texCoords = texCoord >= 0 ? texCoords[texCoord] : glm::vec2(0.0f);
+        out[j].normal = normal >= 0 ? normals[normal] : glm::vec3(0.0f);
+        smooth &= normal >= 0;
+      }
+      // faces without normals are shaded flat
+      if (!smooth)
+      {
+        glm::vec3 normal = faceNormal(out[0].position, out[1].position, out[2].position);
+        out[0].normal = out[1].normal = out[2].normal = normal;
+      }
+    }
+  });
+  if (outOfRange)
+  {
+    std::cout << std::format("{} has face indices out of range", path.string()) << std::endl;
+    return std::nullopt;
+  }
+  return weldVertices(triangles);
+}
+
+// glTF
+
+constexpr uint32_t GLB_MAGIC = 0x46546c67; // "glTF"
+constexpr uint32_t GLB_JSON = 0x4e4f534a;
+constexpr uint32_t GLB_BIN = 0x004e4942;
+constexpr uint32_t GLTF_TRIANGLES = 4;
+
+// a count, offset or index from the document
+size_t integer(const JsonValue& value, size_t fallback = 0)
+{
+  double number = value.number(fallback);
+  if (number < 0 || number > double(1ull << 48) || number != double(size_t(number)))
+    throw std::runtime_error(std::format("{} is not a valid count or index", number));
+  return number;
+}
+
+// a validated view of an accessor's elements; empty if the primitive does not have the attribute
+struct Accessor
+{
+  const uint8_t* data = nullptr;
+  size_t count = 0;
+  size_t stride = 0;
+  // the GL enum of the same value
+  uint32_t componentType = 0;
+  uint32_t components = 0;
+  bool normalized = false;
+
+  float get(size_t element, uint32_t component) const
+  {
+    const uint8_t* at = this->data + element * this->stride;
+    switch (this->componentType)
+    {
+    case GL_FLOAT:
+    {
+      float value;
+      std::memcpy(&value, at + component * sizeof(value), sizeof(value));
+      return value;
+    }
+    case GL_UNSIGNED_BYTE:
+      return this->normalized ? at[component] / 255.0f : at[component];
+    case GL_BYTE:
+      return this->normalized ? std::max(int8_t(at[component]) / 127.0f, -1.0f) : int8_t(at[component]);
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    {
+      uint16_t value;
+      std::memcpy(&value, at + component * sizeof(value), sizeof(value));
+      if (this->componentType == GL_SHORT)
+        return this->normalized ? std::max(int16_t(value) / 32767.0f, -1.0f) : int16_t(value);
+      return this->normalized ? value / 65535.0f : value;
+    }
+    }
+    return 0.0f;
+  }
+
+  uint32_t index(size_t element) const
+  {
+    const uint8_t* at = this->data + element * this->stride;
+    if (this->componentType == GL_UNSIGNED_BYTE)
+      return at[0];
+    if (this->componentType == GL_UNSIGNED_SHORT)
+    {
+      uint16_t value;
+      std::memcpy(&value, at, sizeof(value));
+      return value;
+    }
+    uint32_t value;
+    std::memcpy(&value, at, sizeof(value));
+    return value;
+  }
+};
+
+struct GltfPrimitive
+{
+  Accessor positions;
+  Accessor normals;
+  Accessor texCoords;
+  Accessor indices;
+  glm::mat4 transform;
+};
+
+class GltfDocument
+{
+public:
+  // throws std::runtime_error if the file or a buffer it refers to is malformed
+  GltfDocument(const std::filesystem::path& path, std::span<const uint8_t> file)
+  {
+    std::string_view json((const char*)file.data(), file.size());
+    std::span<const uint8_t> binary;
+    uint32_t magic = 0;
+    if (file.size() >= sizeof(magic))
+      std::memcpy(&magic, file.data(), sizeof(magic));
+    if (magic == GLB_MAGIC)
+    {
+      // a 12-byte header, then chunks of a length, a type and the data, each padded to 4 bytes
+      uint32_t header[3];
+      if (file.size() < sizeof(header))
+        throw std::runtime_error("truncated GLB header");
+      std::memcpy(header, file.data(), sizeof(header));
+      if (header[1] != 2)
+        throw std::runtime_error(std::format("unsupported GLB version {}", header[1]));
+      json = {};
+      for (size_t offset = sizeof(header); offset + 8 <= file.size();)
+      {
+        uint32_t chunk[2];
+        std::memcpy(chunk, file.data() + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk[0] > file.size() - offset)
+          throw std::runtime_error("truncated GLB chunk");
+        if (chunk[1] == GLB_JSON && json.empty())
+          json = {(const char*)file.data() + offset, chunk[0]};
+        else if (chunk[1] == GLB_BIN && binary.empty())
+          binary = file.subspan(offset, chunk[0]);
+        offset += (size_t(chunk[0]) + 3) / 4 * 4;
+      }
+    }
+    this->document = JsonValue::parse(json);
+
+    const JsonValue& buffers = this->document["buffers"];
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+      const JsonValue& buffer = buffers[i];
+      std::span<const uint8_t> data;
+      if (!buffer.contains("uri"))
+        data = i == 0 ? binary : std::span<const uint8_t>();
+      else if (buffer["uri"].string().starts_with("data:"))
+        throw std::runtime_error("embedded data URIs are not supported; use a .glb or external buffers");
+      else
+      {
+        std::filesystem::path uri = path.parent_path() / buffer["uri"].string();
+        this->files.push_back(std::make_unique<MappedFile>(uri));
+        data = this->files.back()->data();
+        this->bytes += data.size();
+      }
+      size_t length = integer(buffer["byteLength"]);
+      if (data.size() < length)
+        throw std::runtime_error(std::format("buffer {} is shorter than its byteLength", i));
+      this->buffers.push_back(data.first(length));
+    }
+  }
+
+  // every triangle primitive of the default scene, with its node's transform, or of every mesh if there is no scene
+  std::vector<GltfPrimitive> primitives() const
+  {
+    std::vector<GltfPrimitive> primitives;
+    const JsonValue& scenes = this->document["scenes"];
+    if (scenes.size() == 0)
+    {
+      for (size_t mesh = 0; mesh < this->document["meshes"].size(); mesh++)
+        this->addMesh(mesh, glm::mat4(1.0f), primitives);
+      return primitives;
+    }
+    const JsonValue& scene = scenes[integer(this->document["scene"])];
+    for (const JsonValue& node : scene["nodes"].array())
+      this->addNode(integer(node), glm::mat4(1.0f), 0, primitives);
+    return primitives;
+  }
+
+  // bytes of the file's buffers that live in their own files
+  size_t bytes = 0;
+
+private:
+  void addNode(size_t index, const glm::mat4& parent, size_t depth, std::vector<GltfPrimitive>& primitives) const
+  {
+    const JsonValue& nodes = this->document["nodes"];
+    // deeper than there are nodes means a cycle
+    if (index >= nodes.size() || depth > nodes.size())
+      throw std::runtime_error(std::format("invalid node hierarchy at node {}", index));
+
+    const JsonValue& node = nodes[index];
+    glm::mat4 local(1.0f);
+    if (node.contains("matrix"))
+    {
+      for (uint32_t i = 0; i < 16; i++)
+        local[i / 4][i % 4] = node["matrix"][i].number();
+    }
+    else
+    {
+      const JsonValue& t = node["translation"];
+      const JsonValue& r = node["rotation"];
+      const JsonValue& s = node["scale"];
+      glm::quat rotation(r[3].number(1), r[0].number(), r[1].number(), r[2].number());
+      local = glm::translate(local, glm::vec3(t[0].number(), t[1].number(), t[2].number()));
+      local = local * glm::mat4_cast(rotation);
+      local = glm::scale(local, glm::vec3(s[0].number(1), s[1].number(1), s[2].number(1)));
+    }
+
+    glm::mat4 world = parent * local;
+    if (node.contains("mesh"))
+      this->addMesh(integer(node["mesh"]), world, primitives);
+    for (const JsonValue& child : node["children"].array())
+      this->addNode(integer(child), world, depth + 1, primitives);
+  }
+
+  void addMesh(size_t index, const glm::mat4& transform, std::vector<GltfPrimitive>& primitives) const
+  {
+    const JsonValue& mesh = this->document["meshes"][index];
+    if (mesh.isNull())
+      throw std::runtime_error(std::format("invalid mesh {}", index));
+    for (const JsonValue& primitive : mesh["primitives"].array())
+    {
+      // points and lines have nothing to fill
+      if (primitive["mode"].number(GLTF_TRIANGLES) != GLTF_TRIANGLES)
+        continue;
+      const JsonValue& attributes = primitive["attributes"];
+      if (!attributes.contains("POSITION"))
+        continue;
+      GltfPrimitive converted = {this->accessor(attributes["POSITION"], {GL_FLOAT}, 3),
+                                 this->accessor(attributes["NORMAL"], {GL_FLOAT, GL_BYTE, GL_SHORT}, 3),
+                                 this->accessor(attributes["TEXCOORD_0"],
+                                                {GL_FLOAT, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT}, 2),
+                                 this->accessor(primitive["indices"],
+                                                {GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT}, 1),
+                                 transform};
+      if (converted.normals.data && converted.normals.count != converted.positions.count)
+        throw std::runtime_error("NORMAL and POSITION counts differ");
+      if (converted.texCoords.data && converted.texCoords.count != converted.positions.count)
+        throw std::runtime_error("TEXCOORD_0 and POSITION counts differ");
+      primitives.push_back(converted);
+    }
+  }
+
+  // looks up and bounds checks an accessor; an absent index gives an empty one
+  Accessor accessor(const JsonValue& index, std::initializer_list<uint32_t> componentTypes, uint32_t components) const
+  {
+    if (index.isNull())
+      return {};
+    const JsonValue& accessor = this->document["accessors"][integer(index)];
+    if (accessor.contains("sparse") || !accessor.contains("bufferView"))
+      throw std::runtime_error("sparse accessors and accessors without a buffer view are not supported");
+
+    static constexpr std::pair<std::string_view, uint32_t> types[] = {
+      {"SCALAR", 1}, {"VEC2", 2}, {"VEC3", 3}, {"VEC4", 4},
+    };
+    uint32_t componentType = accessor["componentType"].number();
+    auto type = std::find_if(std::begin(types), std::end(types),
+                             [&](const auto& type) { return type.first == accessor["type"].string(); });
+    if (std::find(componentTypes.begin(), componentTypes.end(), componentType) == componentTypes.end()
+        || type == std::end(types) || type->second != components)
+      throw std::runtime_error(std::format("accessor {} has an unsupported type", index.number()));
+
+    const JsonValue& view = this->document["bufferViews"][integer(accessor["bufferView"])];
+    size_t buffer = integer(view["buffer"], this->buffers.size());
+    if (buffer >= this->buffers.size())
+      throw std::runtime_error(std::format("accessor {} refers to a missing buffer", index.number()));
+
+    size_t componentBytes = componentType == GL_FLOAT || componentType == GL_UNSIGNED_INT ? 4
+                            : componentType == GL_SHORT || componentType == GL_UNSIGNED_SHORT ? 2
+                                                                                              : 1;
+    size_t elementBytes = componentBytes * components;
+    size_t viewOffset = integer(view["byteOffset"]);
+    size_t viewLength = integer(view["byteLength"]);
+    size_t offset = integer(accessor["byteOffset"]);
+    Accessor result = {nullptr,
+                       integer(accessor["count"]),
+                       integer(view["byteStride"], elementBytes),
+                       componentType,
+                       components,
+                       accessor["normalized"].boolean()};
+    // written so that no sum can overflow
+    size_t bufferSize = this->buffers[buffer].size();
+    if (viewOffset > bufferSize || viewLength > bufferSize - viewOffset || result.stride < elementBytes
+        || (result.count
+            && (offset > viewLength || viewLength - offset < elementBytes
+                || result.count - 1 > (viewLength - offset - elementBytes) / result.stride)))
+      throw std::runtime_error(std::format("accessor {} reads past its buffer", index.number()));
+    result.data = this->buffers[buffer].data() + viewOffset + offset;
+    return result;
+  }
+
+  JsonValue document;
+  std::vector<std::unique_ptr<MappedFile>> files;
+  std::vector<std::span<const uint8_t>> buffers;
+};
+
+// converts a primitive to world space; returns nothing if its indices are out of range
+std::optional<MeshData> convertPrimitive(const GltfPrimitive& primitive)
+{
+  MeshData mesh;
+  glm::mat3 linear(primitive.transform);
+  glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+  // a mirroring transform turns the triangles inside out
+  bool mirrored = glm::determinant(linear) < 0.0f;
+
+  const Accessor& positions = primitive.positions;
+  mesh.vertices.resize(positions.count);
+  for (size_t i = 0; i < positions.count; i++)
+  {
+    Vertex& vertex = mesh.vertices[i];
+    glm::vec3 position(positions.get(i, 0), positions.get(i, 1), positions.get(i, 2));
+    vertex.position = glm::vec3(primitive.transform * glm::vec4(position, 1.0f));
+    vertex.normal = glm::vec3(0.0f);
+    if (primitive.normals.data)
+    {
+      glm::vec3 normal(primitive.normals.get(i, 0), primitive.normals.get(i, 1), primitive.normals.get(i, 2));
+      vertex.normal = glm::normalize(normalMatrix * normal);
+    }
+    vertex.texCoords = glm::vec2(0.0f);
+    if (primitive.texCoords.data)
+      vertex.texCoords = glm::vec2(primitive.texCoords.get(i, 0), primitive.texCoords.get(i, 1));
+  }
+
+  if (primitive.indices.data)
+  {
+    mesh.indices.resize(primitive.indices.count / 3 * 3);
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+      if ((mesh.indices[i] = primitive.indices.index(i)) >= positions.count)
+        return std::nullopt;
+  }
+  else
+  {
+    mesh.indices.resize(positions.count / 3 * 3);
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+      mesh.indices[i] = i;
+  }
+  if (mirrored)
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+      std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+
+  // glTF asks for flat shading when normals are missing, which needs a vertex per face corner
+  if (!primitive.normals.data)
+  {
+    std::vector<Vertex> triangles(mesh.indices.size());
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+      for (uint32_t j = 0; j < 3; j++)
+        triangles[i + j] = mesh.vertices[mesh.indices[i + j]];
+      glm::vec3 normal = faceNormal(triangles[i].position, triangles[i + 1].position, triangles[i + 2].position);
+      triangles[i].normal = triangles[i + 1].normal = triangles[i + 2].normal = normal;
+    }
+    return weldVertices(triangles);
+  }
+  return mesh;
+}
+
+std::optional<MeshData> importGltf(const std::filesystem::path& path, std::span<const uint8_t> file, uint32_t threads,
+                                   size_t& bytes)
+{
+  std::vector<GltfPrimitive> primitives;
+  // the buffers stay mapped until the primitives are converted
+  std::optional<GltfDocument> document;
+  try
+  {
+    document.emplace(path, file);
+    primitives = document->primitives();
+  }
+  catch (const std::runtime_error& error)
+  {
+    std::cout << std::format("{}: {}", path.string(), error.what()) << std::endl;
+    return std::nullopt;
+  }
+  bytes += document->bytes;
+
+  std::vector<std::optional<MeshData>> parts(primitives.size());
+  parallelFor(primitives.size(), threads, [&](uint32_t i) { parts[i] = convertPrimitive(primitives[i]); });
+
+  MeshData mesh;
+  for (std::optional<MeshData>& part : parts)
+  {
+    if (!part)
+    {
+      std::cout << std::format("{} has indices out of range", path.string()) << std::endl;
+      return std::nullopt;
+    }
+    uint32_t base = mesh.vertices.size();
+    mesh.vertices.insert(mesh.vertices.end(), part->vertices.begin(), part->vertices.end());
+    for (uint32_t index : part->indices)
+      mesh.indices.push_back(base + index);
+  }
+  if (mesh.indices.empty())
+  {
+    std::cout << std::format("{} has no triangles", path.string()) << std::endl;
+    return std::nullopt;
+  }
+  return mesh;
+}
+
+// cache
+
+constexpr uint32_t MAGIC = 0x484d474c; // "LGMH"
+constexpr uint32_t VERSION = 2;
+// vertex and index data start at this alignment within the file
+constexpr size_t ALIGNMENT = 16;
+
+static_assert(std::is_trivially_copyable_v<MeshLayout>);
+
+struct Header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  MeshLayout layout;
+  uint64_t vertexOffset;
+  uint64_t vertexBytes;
+  uint64_t indexOffset;
+  uint64_t indexBytes;
+};
+
+size_t align(size_t offset)
+{
+  return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+}
+
+std::optional<MeshData> importMesh(const std::filesystem::path& path, uint32_t threads)
+{
+  Clock::time_point start = Clock::now();
+  MappedFile file(path);
+  if (!file)
+  {
+    std::cout << std::format("Failed to open mesh {}", path.string()) << std::endl;
+    return std::nullopt;
+  }
+
+  threads = threadCount(threads);
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return std::tolower(c); });
+  size_t bytes = file.data().size();
+  std::optional<MeshData> mesh;
+  if (extension == ".obj")
+    mesh = importObj(path, std::string_view((const char*)file.data().data(), file.data().size()), threads);
+  else if (extension == ".gltf" || extension == ".glb")
+    mesh = importGltf(path, file.data(), threads, bytes);
+  else
+    std::cout << std::format("Unsupported mesh format {}", path.string()) << std::endl;
+
+  if (mesh)
+  {
+    std::chrono::duration<double> time = Clock::now() - start;
+    std::cout << std::format("Imported {}: {} triangles, {} vertices in {:.1f} ms on {} threads ({:.0f} MB/s)",
+                             path.string(), mesh->indices.size() / 3, mesh->vertices.size(), time.count() * 1e3,
+                             threads, bytes / 1e6 / time.count())
+              << std::endl;
+  }
+  return mesh;
+}
+
+uint64_t MeshCache::key(const std::filesystem::path& source, const VertexFormat& format)
+{
+  std::error_code error;
+  std::filesystem::path absolute = std::filesystem::absolute(source, error);
+  uint64_t size = std::filesystem::file_size(source, error);
+  int64_t modified = std::filesystem::last_write_time(source, error).time_since_epoch().count();
+
+  uint64_t hash = fnv1a(absolute.string());
+  hash = fnv1a(std::string_view((const char*)&size, sizeof(size)), hash);
+  hash = fnv1a(std::string_view((const char*)&modified, sizeof(modified)), hash);
+  hash = fnv1a(std::string_view((const char*)&format, sizeof(format)), hash);
+  return hash;
+}
+
+std::optional<CachedMesh> MeshCache::load(uint64_t key)
+{
+  std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>(path(key));
+  if (!*file || file->data().size() < sizeof(Header))
+    return std::nullopt;
+
+  Header header;
+  std::memcpy(&header, file->data().data(), sizeof(header));
+  const MeshLayout& layout = header.layout;
+  if (header.magic != MAGIC || header.version != VERSION || header.key != key)
+    return std::nullopt;
+  // also catches a file cut short by a crash while it was written
+  size_t indexBytes = layout.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+  if ((layout.indexType != GL_UNSIGNED_SHORT && layout.indexType != GL_UNSIGNED_INT)
+      || header.vertexBytes != size_t(layout.vertexCount) * layout.format.stride()
+      || header.indexBytes != size_t(layout.indexCount) * indexBytes
+      || header.vertexOffset + header.vertexBytes > file->data().size()
+      || header.indexOffset + header.indexBytes > file->data().size())
+    return std::nullopt;
+
+  std::span<const uint8_t> vertices = file->data().subspan(header.vertexOffset, header.vertexBytes);
+  std::span<const uint8_t> indices = file->data().subspan(header.indexOffset, header.indexBytes);
+  return CachedMesh{std::move(file), layout, vertices, indices};
+}
+
+void MeshCache::store(uint64_t key, const EncodedMesh& mesh)
+{
+  std::error_code error;
+  std::filesystem::create_directories(directory(), error);
+  if (error)
+  {
+    std::cout << std::format("Failed to create mesh cache directory {}: {}", directory().string(), error.message())
+              << std::endl;
+    return;
+  }
+
+  Header header = {MAGIC, VERSION, key, mesh.layout, align(sizeof(Header)), mesh.vertices.size(), 0,
+                   mesh.indices.size()};
+  header.indexOffset = align(header.vertexOffset + header.vertexBytes);
+  const char padding[ALIGNMENT] = {};
+  std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+  file.write((const char*)&header, sizeof(header));
+  file.write(padding, header.vertexOffset - sizeof(header));
+  file.write((const char*)mesh.vertices.data(), mesh.vertices.size());
+  file.write(padding, header.indexOffset - header.vertexOffset - header.vertexBytes);
+  file.write((const char*)mesh.indices.data(), mesh.indices.size());
+}
+
+std::filesystem::path MeshCache::directory()
+{
+  if (const char* cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome)
+    return std::filesystem::path(cacheHome) / "learn-opengl" / "meshes";
+  if (const char* home = std::getenv("HOME"); home && *home)
+    return std::filesystem::path(home) / ".cache" / "learn-opengl" / "meshes";
+  return std::filesystem::path(".cache") / "meshes";
+}
+
+std::filesystem::path MeshCache::path(uint64_t key)
+{
+  return directory() / std::format("{:016x}.mesh", key);
+}
+
+std::unique_ptr<Mesh> loadMesh(const std::filesystem::path& path, const VertexFormat& format)
+{
+  Clock::time_point start = Clock::now();
+  uint64_t key = MeshCache::key(path, format);
+  if (std::optional<CachedMesh> cached = MeshCache::load(key))
+  {
+    std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(cached->layout, cached->vertices, cached->indices);
+    MeshCache::hits++;
+    MeshCache::loadTime += Clock::now() - start;
+    return mesh;
+  }
+
+  MeshCache::misses++;
+  std::optional<MeshData> data = importMesh(path);
+  if (!data)
+    return nullptr;
+  // reordering is slow enough for large meshes that only the cache makes it free
+  Clock::time_point optimizeStart = Clock::now();
+  MeshOptimization optimization = optimizeMesh(*data);
+  std::cout << std::format("Optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f} in {:.1f} ms", path.string(),
+                           optimization.before.acmr, optimization.after.acmr, optimization.before.atvr,
+                           optimization.after.atvr,
+                           std::chrono::duration<double, std::milli>(Clock::now() - optimizeStart).count())
+            << std::endl;
+  EncodedMesh encoded = encodeMesh(*data, format);
+  MeshCache::store(key, encoded);
+  std::unique_ptr<Mesh> mesh = std::make_unique<Mesh>(encoded.layout, encoded.vertices, encoded.indices);
+  MeshCache::importTime += Clock::now() - start;
+  return mesh;
+}
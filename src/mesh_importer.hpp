@@ -0,0 +1,50 @@
+#pragma once
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+
+// Reads the triangles of an OBJ or glTF 2.0 (.gltf or .glb) file into one indexed mesh, or returns nothing and logs
+// why if the file is unreadable or malformed. Files are memory mapped. OBJ text is split into line ranges that parse
+// on a thread each, and its face corners are welded into shared vertices. glTF primitives convert on a thread each,
+// with the transforms of the default scene's nodes applied. threads = 0 uses one per core.
+std::optional<MeshData> importMesh(const std::filesystem::path& path, uint32_t threads = 0);
+
+// An encoded mesh read from a cache file, pointing into its mapping
+struct CachedMesh
+{
+  std::unique_ptr<MappedFile> file;
+  MeshLayout layout;
+  std::span<const uint8_t> vertices;
+  std::span<const uint8_t> indices;
+};
+
+// On-disk cache of imported meshes in the layout their GPU buffers take, keyed by the source file and vertex format.
+// A hit maps the file and uploads its buffers without copying them.
+class MeshCache
+{
+public:
+  // changes when the source file is modified or moved
+  static uint64_t key(const std::filesystem::path& source, const VertexFormat& format);
+
+  // returns nothing on a miss or if the file is stale or truncated
+  static std::optional<CachedMesh> load(uint64_t key);
+  static void store(uint64_t key, const EncodedMesh& mesh);
+
+  static inline uint32_t hits = 0;
+  static inline uint32_t misses = 0;
+  static inline std::chrono::duration<double, std::milli> loadTime;
+  static inline std::chrono::duration<double, std::milli> importTime;
+
+private:
+  static std::filesystem::path directory();
+  static std::filesystem::path path(uint64_t key);
+};
+
+// uploads a mesh from the cache. On a miss it is imported, reordered with optimizeMesh() and cached. Returns null if
+// it cannot be imported.
+std::unique_ptr<Mesh> loadMesh(const std::filesystem::path& path, const VertexFormat& format = {});
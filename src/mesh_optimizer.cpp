@@ -0,0 +1,288 @@
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+// Forsyth's tuning
+constexpr uint32_t SCORE_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+// valences above this score the same
+constexpr uint32_t MAX_VALENCE = 32;
+// the cache optimizeOverdraw() keeps the miss ratio of
+constexpr uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+struct ScoreTables
+{
+  ScoreTables()
+  {
+    for (uint32_t position = 0; position < SCORE_CACHE_SIZE; position++)
+      // the last triangle's vertices score lower than the next ones in, so it is not picked again straight away
+      this->cache[position] = position < 3 ? LAST_TRIANGLE_SCORE
+                                           : std::pow(1.0f - float(position - 3) / (SCORE_CACHE_SIZE - 3),
+                                                      CACHE_DECAY_POWER);
+    this->valence[0] = 0.0f;
+    for (uint32_t triangles = 1; triangles <= MAX_VALENCE; triangles++)
+      // vertices with few triangles left are finished off first, so they stop holding their neighbours back
+      this->valence[triangles] = VALENCE_BOOST_SCALE * std::pow(float(triangles), -VALENCE_BOOST_POWER);
+  }
+
+  // -1 for vertices that are not cached
+  float score(int32_t cachePosition, uint32_t liveTriangles) const
+  {
+    if (liveTriangles == 0)
+      return -1.0f;
+    float score = this->valence[std::min(liveTriangles, MAX_VALENCE)];
+    return cachePosition >= 0 ? score + this->cache[cachePosition] : score;
+  }
+
+  float cache[SCORE_CACHE_SIZE];
+  float valence[MAX_VALENCE + 1];
+};
+
+// A FIFO cache of transformed vertices. A vertex is cached while fewer than size misses followed its own.
+class FifoCache
+{
+public:
+  FifoCache(uint32_t vertexCount, uint32_t size)
+    : stamps(vertexCount, 0), size(size)
+  {
+  }
+
+  // returns how many of the triangle's vertices missed
+  uint32_t add(const uint32_t* triangle)
+  {
+    uint64_t before = this->misses;
+    for (uint32_t i = 0; i < 3; i++)
+      if (this->stamps[triangle[i]] == 0 || this->misses - this->stamps[triangle[i]] >= this->size)
+        this->stamps[triangle[i]] = ++this->misses;
+    return this->misses - before;
+  }
+
+  // empties the cache without forgetting which vertices were ever transformed
+  void clear() { this->misses += this->size; }
+
+  uint64_t misses = 0;
+  std::vector<uint64_t> stamps;
+
+private:
+  uint32_t size;
+};
+}
+
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+  FifoCache cache(vertexCount, cacheSize);
+  for (size_t i = 0; i + 3 <= indices.size(); i += 3)
+    cache.add(&indices[i]);
+  size_t referenced = std::count_if(cache.stamps.begin(), cache.stamps.end(), [](uint64_t stamp) { return stamp; });
+  size_t triangles = indices.size() / 3;
+  return {triangles ? float(cache.misses) / triangles : 0.0f, referenced ? float(cache.misses) / referenced : 0.0f};
+}
+
+std::vector<size_t> optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount)
+{
+  static const ScoreTables tables;
+  size_t triangleCount = indices.size() / 3;
+  std::vector<size_t> restarts;
+  if (triangleCount == 0)
+    return restarts;
+
+  // the triangles using each vertex, as ranges of one array. The first live[vertex] entries of a range are the ones
+  // not emitted yet.
+  std::vector<uint32_t> offsets(vertexCount + 1, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++)
+    offsets[indices[i] + 1]++;
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  std::vector<uint32_t> adjacency(triangleCount * 3);
+  std::vector<uint32_t> live(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++)
+    adjacency[offsets[indices[i]] + live[indices[i]]++] = i / 3;
+
+  std::vector<int32_t> cachePositions(vertexCount, -1);
+  std::vector<float> scores(vertexCount);
+  for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+    scores[vertex] = tables.score(-1, live[vertex]);
+  auto triangleScore = [&](uint32_t triangle) {
+    return scores[indices[triangle * 3]] + scores[indices[triangle * 3 + 1]] + scores[indices[triangle * 3 + 2]];
+  };
+
+  std::vector<uint32_t> sorted;
+  sorted.reserve(triangleCount * 3);
+  std::vector<bool> emitted(triangleCount, false);
+  // an emitted triangle's vertices can push three out of a full cache
+  uint32_t cache[SCORE_CACHE_SIZE + 3];
+  uint32_t cacheCount = 0;
+  size_t nextInput = 0;
+  int64_t best = -1;
+  while (sorted.size() < triangleCount * 3)
+  {
+    // when no cached vertex has triangles left, start over from the earliest remaining one in the input
+    if (best < 0)
+    {
+      while (emitted[nextInput])
+        nextInput++;
+      best = nextInput;
+      restarts.push_back(sorted.size() / 3);
+    }
+    const uint32_t* triangle = &indices[best * 3];
+    sorted.insert(sorted.end(), triangle, triangle + 3);
+    emitted[best] = true;
+
+    uint32_t updated[SCORE_CACHE_SIZE + 3];
+    uint32_t updatedCount = 0;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+      uint32_t vertex = triangle[i];
+      uint32_t* triangles = &adjacency[offsets[vertex]];
+      *std::find(triangles, triangles + live[vertex], uint32_t(best)) = triangles[live[vertex] - 1];
+      live[vertex]--;
+      // a degenerate triangle repeats a vertex
+      if (std::find(updated, updated + updatedCount, vertex) == updated + updatedCount)
+        updated[updatedCount++] = vertex;
+    }
+    // the triangle's vertices move to the front and push the rest back
+    for (uint32_t i = 0; i < cacheCount; i++)
+      if (std::find(updated, updated + updatedCount, cache[i]) == updated + updatedCount)
+        updated[updatedCount++] = cache[i];
+    for (uint32_t i = 0; i < updatedCount; i++)
+    {
+      uint32_t vertex = updated[i];
+      cachePositions[vertex] = i < SCORE_CACHE_SIZE ? i : -1;
+      scores[vertex] = tables.score(cachePositions[vertex], live[vertex]);
+    }
+    cacheCount = std::min(updatedCount, SCORE_CACHE_SIZE);
+    std::copy(updated, updated + cacheCount, cache);
+
+    best = -1;
+    float bestScore = 0.0f;
+    for (uint32_t i = 0; i < cacheCount; i++)
+      for (uint32_t j = 0; j < live[cache[i]]; j++)
+      {
+        uint32_t candidate = adjacency[offsets[cache[i]] + j];
+        if (float score = triangleScore(candidate); best < 0 || score > bestScore)
+        {
+          best = candidate;
+          bestScore = score;
+        }
+      }
+  }
+  std::copy(sorted.begin(), sorted.end(), indices.begin());
+  return restarts;
+}
+
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, std::span<const size_t> restarts,
+                      float threshold)
+{
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+    return;
+
+  // the cache-optimized order starts over where no cached vertex had triangles left, so reordering across those
+  // points cannot cost the cache anything it did not already lose; clusters move freely between them
+  std::vector<size_t> hardBoundaries = {0};
+  for (size_t restart : restarts)
+    if (restart > hardBoundaries.back() && restart < triangleCount)
+      hardBoundaries.push_back(restart);
+  hardBoundaries.push_back(triangleCount);
+  FifoCache cache(vertices.size(), OVERDRAW_CACHE_SIZE);
+
+  // splitting a cluster where its misses so far are low enough keeps the cost to the cache within the threshold
+  std::vector<size_t> clusters;
+  for (size_t i = 0; i + 1 < hardBoundaries.size(); i++)
+  {
+    size_t start = hardBoundaries[i];
+    size_t end = hardBoundaries[i + 1];
+    cache.clear();
+    uint64_t misses = cache.misses;
+    for (size_t triangle = start; triangle < end; triangle++)
+      cache.add(&indices[triangle * 3]);
+    float limit = threshold * float(cache.misses - misses) / (end - start);
+
+    cache.clear();
+    misses = cache.misses;
+    clusters.push_back(start);
+    for (size_t triangle = start; triangle + 1 < end; triangle++)
+    {
+      cache.add(&indices[triangle * 3]);
+      if (float(cache.misses - misses) / (triangle + 1 - clusters.back()) <= limit)
+      {
+        clusters.push_back(triangle + 1);
+        cache.clear();
+        misses = cache.misses;
+      }
+    }
+  }
+  clusters.push_back(triangleCount);
+
+  glm::vec3 meshCentre(0.0f);
+  for (const Vertex& vertex : vertices)
+    meshCentre += vertex.position;
+  meshCentre = meshCentre / float(std::max<size_t>(vertices.size(), 1));
+
+  // clusters facing away from the centre, and far from it, are the likeliest to be in front, so they draw first
+  std::vector<float> outwardness(clusters.size() - 1);
+  for (size_t cluster = 0; cluster + 1 < clusters.size(); cluster++)
+  {
+    glm::vec3 centre(0.0f);
+    glm::vec3 normal(0.0f);
+    float area = 0.0f;
+    for (size_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+    {
+      glm::vec3 a = vertices[indices[triangle * 3]].position;
+      glm::vec3 b = vertices[indices[triangle * 3 + 1]].position;
+      glm::vec3 c = vertices[indices[triangle * 3 + 2]].position;
+      // twice the area, pointing along the face normal
+      glm::vec3 cross = glm::cross(b - a, c - a);
+      float weight = glm::length(cross);
+      centre += (a + b + c) * (weight / 3.0f);
+      normal += cross;
+      area += weight;
+    }
+    float normalLength = glm::length(normal);
+    if (area > 0.0f && normalLength > 0.0f)
+      outwardness[cluster] = glm::dot(centre / area - meshCentre, normal / normalLength);
+  }
+
+  std::vector<uint32_t> order(outwardness.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return outwardness[a] > outwardness[b]; });
+  std::vector<uint32_t> sorted;
+  sorted.reserve(triangleCount * 3);
+  for (uint32_t cluster : order)
+    sorted.insert(sorted.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+  std::copy(sorted.begin(), sorted.end(), indices.begin());
+}
+
+void optimizeVertexFetch(MeshData& mesh)
+{
+  std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+  std::vector<Vertex> vertices;
+  vertices.reserve(mesh.vertices.size());
+  for (uint32_t& index : mesh.indices)
+  {
+    if (remap[index] == UINT32_MAX)
+    {
+      remap[index] = vertices.size();
+      vertices.push_back(mesh.vertices[index]);
+    }
+    index = remap[index];
+  }
+  mesh.vertices = std::move(vertices);
+}
+
+MeshOptimization optimizeMesh(MeshData& mesh)
+{
+  MeshOptimization result;
+  result.before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+  std::vector<size_t> restarts = optimizeVertexCache(mesh.indices, mesh.vertices.size());
+  optimizeOverdraw(mesh.indices, mesh.vertices, restarts);
+  optimizeVertexFetch(mesh);
+  result.after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+  return result;
+}
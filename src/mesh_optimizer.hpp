@@ -0,0 +1,43 @@
+#pragma once
+#include "mesh.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// How well an index buffer reuses the post-transform vertex cache, simulated as a FIFO of transformed vertices
+struct VertexCacheStats
+{
+  // average cache miss ratio: vertex shader invocations per triangle, from 3 down to about 0.5 for regular meshes
+  float acmr;
+  // average transform to vertex ratio: invocations per vertex referenced, from 1 at best up to 6
+  float atvr;
+};
+
+// GPUs keep somewhere between 16 and 32 transformed vertices
+VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices, uint32_t vertexCount, uint32_t cacheSize = 16);
+
+// Reorders triangles so their vertices are reused while still in the post-transform cache. This is Tom Forsyth's
+// linear-speed algorithm: vertices score by how recently they entered a simulated LRU cache and by how few triangles
+// still use them, and the next triangle is the best-scoring one that shares a vertex with the cache. Returns the
+// triangles where the order starts over because no cached vertex had triangles left, beginning with 0.
+std::vector<size_t> optimizeVertexCache(std::span<uint32_t> indices, uint32_t vertexCount);
+// Reorders clusters of triangles so those facing out from the mesh's centre come first, which lets early depth
+// testing reject more of what is drawn after them. Clusters never span the restarts optimizeVertexCache() returned,
+// and split the order between them wherever that costs the cache at most threshold times its run's miss ratio, as in
+// Sander et al.'s Tipsify paper.
+void optimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, std::span<const size_t> restarts,
+                      float threshold = 1.05f);
+// renumbers vertices in the order the triangles first use them, so vertex fetches read memory in order, and drops
+// vertices no triangle uses
+void optimizeVertexFetch(MeshData& mesh);
+
+// the statistics before and after optimizeMesh()
+struct MeshOptimization
+{
+  VertexCacheStats before;
+  VertexCacheStats after;
+};
+
+// runs the three passes in order; the mesh draws the same triangles afterwards
+MeshOptimization optimizeMesh(MeshData& mesh);
@@ -0,0 +1,492 @@
+#include "mipmap.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numbers>
+#include <thread>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define MIPMAP_SSE2
+// AVX2 is not part of the x86-64 baseline, so those kernels are compiled for it separately and picked at runtime
+#if defined(__GNUC__)
+#define MIPMAP_AVX2
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIPMAP_NEON
+#endif
+
+namespace
+{
+// Output pixel x is centered between source pixels 2x and 2x+1. A kernel's weights apply to source pixels
+// 2x + offset onwards, for both rows and columns.
+struct Kernel
+{
+  std::vector<float> weights;
+  int32_t offset;
+};
+
+float sinc(float x)
+{
+  if (x == 0.0f)
+    return 1.0f;
+  x *= std::numbers::pi_v<float>;
+  return std::sin(x) / x;
+}
+
+// zeroth order modified Bessel function of the first kind, which shapes the Kaiser window
+float besselI0(float x)
+{
+  float sum = 1.0f;
+  float term = 1.0f;
+  for (int32_t k = 1; k < 16; k++)
+  {
+    term *= (x / (2.0f * k)) * (x / (2.0f * k));
+    sum += term;
+  }
+  return sum;
+}
+
+Kernel makeKernel(MipFilter filter)
+{
+  if (filter == MipFilter::Box)
+    return {{0.5f, 0.5f}, 0};
+
+  // a sinc low-pass at the output's Nyquist frequency, windowed to 3 output pixels on either side
+  constexpr float radius = 3.0f;
+  constexpr float alpha = 4.0f;
+  Kernel kernel = {std::vector<float>(12), -5};
+  float total = 0.0f;
+  for (int32_t i = 0; i < 12; i++)
+  {
+    // distance between the source and output pixel centers, in output pixels
+    float t = (kernel.offset + i - 0.5f) / 2.0f;
+    float window = filter == MipFilter::Lanczos
+                     ? sinc(t / radius)
+                     : besselI0(alpha * std::sqrt(1.0f - (t / radius) * (t / radius))) / besselI0(alpha);
+    kernel.weights[i] = sinc(t) * window;
+    total += kernel.weights[i];
+  }
+  for (float& weight : kernel.weights)
+    weight /= total;
+  return kernel;
+}
+
+struct Tables
+{
+  float unorm[256];
+  float srgbToLinear[256];
+  // indexed by a linear value scaled to 0-4095, which is finer than 8-bit sRGB's darkest step
+  uint8_t linearToSrgb[4096];
+};
+
+const Tables& tables()
+{
+  static const Tables tables = [] {
+    Tables tables;
+    for (int32_t i = 0; i < 256; i++)
+    {
+      float value = i / 255.0f;
+      tables.unorm[i] = value;
+      tables.srgbToLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int32_t i = 0; i < 4096; i++)
+    {
+      float value = i / 4095.0f;
+      float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+      tables.linearToSrgb[i] = uint8_t(encoded * 255.0f + 0.5f);
+    }
+    return tables;
+  }();
+  return tables;
+}
+
+bool hasAvx2()
+{
+#ifdef MIPMAP_AVX2
+  static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// the channel left linear when filtering sRGB images
+int32_t alphaChannel(uint32_t components)
+{
+  return components == 2 || components == 4 ? components - 1 : -1;
+}
+
+// output = sum of weights[k] * rows[k], over count floats
+void filterRowsScalar(const float* const* rows, const float* weights, uint32_t taps, float* output, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    float sum = 0.0f;
+    for (uint32_t k = 0; k < taps; k++)
+      sum += weights[k] * rows[k][i];
+    output[i] = sum;
+  }
+}
+
+#ifdef MIPMAP_AVX2
+AVX2_TARGET void filterRowsAvx2(const float* const* rows, const float* weights, uint32_t taps, float* output,
+                                size_t count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t k = 0; k < taps; k++)
+      sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i), sum);
+    _mm256_storeu_ps(output + i, sum);
+  }
+  for (; i < count; i++)
+  {
+    float sum = 0.0f;
+    for (uint32_t k = 0; k < taps; k++)
+      sum += weights[k] * rows[k][i];
+    output[i] = sum;
+  }
+}
+#endif
+
+void filterRowsSimd(const float* const* rows, const float* weights, uint32_t taps, float* output, size_t count,
+                    bool avx2)
+{
+#ifdef MIPMAP_AVX2
+  if (avx2)
+    return filterRowsAvx2(rows, weights, taps, output, count);
+#endif
+  size_t i = 0;
+#if defined(MIPMAP_SSE2)
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t k = 0; k < taps; k++)
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+    _mm_storeu_ps(output + i, sum);
+  }
+#elif defined(MIPMAP_NEON)
+  for (; i + 4 <= count; i += 4)
+  {
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for (uint32_t k = 0; k < taps; k++)
+      sum = vmlaq_n_f32(sum, vld1q_f32(rows[k] + i), weights[k]);
+    vst1q_f32(output + i, sum);
+  }
+#endif
+  for (; i < count; i++)
+  {
+    float sum = 0.0f;
+    for (uint32_t k = 0; k < taps; k++)
+      sum += weights[k] * rows[k][i];
+    output[i] = sum;
+  }
+}
+
+// horizontal pass: output pixel x = sum of weights[k] * input pixel 2x + offset + k, clamped to the row
+void filterColumnsScalar(const float* input, uint32_t width, uint32_t components, const Kernel& kernel, float* output,
+                         uint32_t outputWidth)
+{
+  for (uint32_t x = 0; x < outputWidth; x++)
+    for (uint32_t c = 0; c < components; c++)
+    {
+      float sum = 0.0f;
+      for (uint32_t k = 0; k < kernel.weights.size(); k++)
+      {
+        int32_t source = std::clamp<int32_t>(int32_t(2 * x + k) + kernel.offset, 0, width - 1);
+        sum += kernel.weights[k] * input[size_t(source) * components + c];
+      }
+      output[size_t(x) * components + c] = sum;
+    }
+}
+
+void filterColumnsSimd(const float* input, uint32_t width, uint32_t components, const Kernel& kernel, float* output,
+                       uint32_t outputWidth)
+{
+#if defined(MIPMAP_SSE2) || defined(MIPMAP_NEON)
+  // one RGBA pixel fills a vector; other layouts do not line up with it
+  if (components == 4)
+  {
+    for (uint32_t x = 0; x < outputWidth; x++)
+    {
+#ifdef MIPMAP_SSE2
+      __m128 sum = _mm_setzero_ps();
+#else
+      float32x4_t sum = vdupq_n_f32(0.0f);
+#endif
+      for (uint32_t k = 0; k < kernel.weights.size(); k++)
+      {
+        int32_t source = std::clamp<int32_t>(int32_t(2 * x + k) + kernel.offset, 0, width - 1);
+        const float* pixel = input + size_t(source) * 4;
+#ifdef MIPMAP_SSE2
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel.weights[k]), _mm_loadu_ps(pixel)));
+#else
+        sum = vmlaq_n_f32(sum, vld1q_f32(pixel), kernel.weights[k]);
+#endif
+      }
+#ifdef MIPMAP_SSE2
+      _mm_storeu_ps(output + size_t(x) * 4, sum);
+#else
+      vst1q_f32(output + size_t(x) * 4, sum);
+#endif
+    }
+    return;
+  }
+#endif
+  filterColumnsScalar(input, width, components, kernel, output, outputWidth);
+}
+
+void encodeLinearScalar(const float* input, size_t count, uint8_t* output)
+{
+  for (size_t i = 0; i < count; i++)
+    output[i] = uint8_t(std::clamp(input[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+void encodeLinearSimd(const float* input, size_t count, uint8_t* output)
+{
+  size_t i = 0;
+#if defined(MIPMAP_SSE2)
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (; i + 16 <= count; i += 16)
+  {
+    // truncating after adding a half matches the scalar rounding exactly
+    __m128i values[4];
+    for (int32_t j = 0; j < 4; j++)
+    {
+      __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i + j * 4), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+      values[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half));
+    }
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(values[0], values[1]), _mm_packs_epi32(values[2], values[3]));
+    _mm_storeu_si128((__m128i*)(output + i), packed);
+  }
+#elif defined(MIPMAP_NEON)
+  for (; i + 8 <= count; i += 8)
+  {
+    float32x4_t low = vminq_f32(vmaxq_f32(vld1q_f32(input + i), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    float32x4_t high = vminq_f32(vmaxq_f32(vld1q_f32(input + i + 4), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+    uint32x4_t lowInt = vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), low, 255.0f));
+    uint32x4_t highInt = vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), high, 255.0f));
+    vst1_u8(output + i, vmovn_u16(vcombine_u16(vmovn_u32(lowInt), vmovn_u32(highInt))));
+  }
+#endif
+  encodeLinearScalar(input + i, count - i, output + i);
+}
+
+// the 2x2 box filter on 8-bit values, rounding like glGenerateMipmap; used for linear images
+void boxRowScalar(const uint8_t* row0, const uint8_t* row1, uint32_t width, uint32_t components, uint8_t* output,
+                  uint32_t outputWidth)
+{
+  for (uint32_t x = 0; x < outputWidth; x++)
+  {
+    size_t x0 = size_t(std::min(x * 2, width - 1)) * components;
+    size_t x1 = size_t(std::min(x * 2 + 1, width - 1)) * components;
+    for (uint32_t c = 0; c < components; c++)
+      output[size_t(x) * components + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4;
+  }
+}
+
+#ifdef MIPMAP_AVX2
+// four RGBA output pixels from eight input pixels per row; returns the pixels written
+AVX2_TARGET uint32_t boxRowAvx2(const uint8_t* row0, const uint8_t* row1, uint32_t outputWidth, uint8_t* output)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i two = _mm256_set1_epi16(2);
+  uint32_t x = 0;
+  for (; x + 4 <= outputWidth; x += 4)
+  {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(row0 + size_t(x) * 8));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(row1 + size_t(x) * 8));
+    // each 128-bit lane holds four source pixels, widened to 16 bits per channel and summed down the column
+    __m256i low = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+    __m256i high = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+    __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(low, high), _mm256_unpackhi_epi64(low, high));
+    sum = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0b1000);
+    _mm_storeu_si128((__m128i*)(output + size_t(x) * 4), _mm256_castsi256_si128(packed));
+  }
+  return x;
+}
+#endif
+
+void boxRowSimd(const uint8_t* row0, const uint8_t* row1, uint32_t width, uint32_t components, uint8_t* output,
+                uint32_t outputWidth, bool avx2)
+{
+  uint32_t x = 0;
+  // every output pixel before outputWidth reads two whole source pixels, so only RGBA needs no shuffling
+  if (components == 4)
+  {
+#ifdef MIPMAP_AVX2
+    if (avx2)
+      x = boxRowAvx2(row0, row1, outputWidth, output);
+#endif
+#if defined(MIPMAP_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= outputWidth; x += 2)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*)(row0 + size_t(x) * 8));
+      __m128i b = _mm_loadu_si128((const __m128i*)(row1 + size_t(x) * 8));
+      __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+      __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+      __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+      sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+      _mm_storel_epi64((__m128i*)(output + size_t(x) * 4), _mm_packus_epi16(sum, sum));
+    }
+#elif defined(MIPMAP_NEON)
+    for (; x + 2 <= outputWidth; x += 2)
+    {
+      uint8x16_t a = vld1q_u8(row0 + size_t(x) * 8);
+      uint8x16_t b = vld1q_u8(row1 + size_t(x) * 8);
+      uint16x8_t low = vaddl_u8(vget_low_u8(a), vget_low_u8(b));
+      uint16x8_t high = vaddl_u8(vget_high_u8(a), vget_high_u8(b));
+      uint16x8_t sum = vcombine_u16(vadd_u16(vget_low_u16(low), vget_high_u16(low)),
+                                    vadd_u16(vget_low_u16(high), vget_high_u16(high)));
+      // rounding narrow: (sum + 2) >> 2
+      vst1_u8(output + size_t(x) * 4, vrshrn_n_u16(sum, 2));
+    }
+#endif
+  }
+  size_t done = size_t(x) * components;
+  boxRowScalar(row0 + done * 2, row1 + done * 2, width - x * 2, components, output + done, outputWidth - x);
+}
+
+// Filters output rows [first, last) of one level. Source rows are decoded to floats once and kept in a ring that
+// the kernel slides down, two rows per output row.
+void downsampleRows(const uint8_t* input, uint32_t width, uint32_t height, uint32_t components, MipLevel& level,
+                    uint32_t first, uint32_t last, const Kernel& kernel, const MipmapOptions& options)
+{
+  size_t rowBytes = size_t(width) * components;
+  size_t outputRowBytes = size_t(level.width) * components;
+  bool avx2 = options.avx2 && hasAvx2();
+
+  if (kernel.weights.size() == 2 && !options.srgb)
+  {
+    for (uint32_t y = first; y < last; y++)
+    {
+      const uint8_t* row0 = input + std::min(y * 2, height - 1) * rowBytes;
+      const uint8_t* row1 = input + std::min(y * 2 + 1, height - 1) * rowBytes;
+      uint8_t* output = level.pixels.data() + y * outputRowBytes;
+      if (options.simd)
+        boxRowSimd(row0, row1, width, components, output, level.width, avx2);
+      else
+        boxRowScalar(row0, row1, width, components, output, level.width);
+    }
+    return;
+  }
+
+  const Tables& lookup = tables();
+  const float* decode[4];
+  for (uint32_t c = 0; c < components; c++)
+    decode[c] = options.srgb && int32_t(c) != alphaChannel(components) ? lookup.srgbToLinear : lookup.unorm;
+
+  uint32_t taps = kernel.weights.size();
+  std::vector<float> ring(rowBytes * taps);
+  std::vector<int64_t> ringRows(taps, INT64_MIN);
+  std::vector<const float*> rows(taps);
+  std::vector<float> vertical(rowBytes);
+  std::vector<float> horizontal(outputRowBytes);
+
+  for (uint32_t y = first; y < last; y++)
+  {
+    for (uint32_t k = 0; k < taps; k++)
+    {
+      // rows above the image are negative, and clamp to the first row when decoded
+      int64_t row = int64_t(y) * 2 + kernel.offset + k;
+      size_t index = (row % taps + taps) % taps;
+      float* slot = ring.data() + index * rowBytes;
+      if (ringRows[index] != row)
+      {
+        const uint8_t* source = input + std::clamp<int64_t>(row, 0, height - 1) * rowBytes;
+        for (size_t i = 0; i < rowBytes; i += components)
+          for (uint32_t c = 0; c < components; c++)
+            slot[i + c] = decode[c][source[i + c]];
+        ringRows[index] = row;
+      }
+      rows[k] = slot;
+    }
+
+    uint8_t* output = level.pixels.data() + y * outputRowBytes;
+    if (options.simd)
+    {
+      filterRowsSimd(rows.data(), kernel.weights.data(), taps, vertical.data(), rowBytes, avx2);
+      filterColumnsSimd(vertical.data(), width, components, kernel, horizontal.data(), level.width);
+    }
+    else
+    {
+      filterRowsScalar(rows.data(), kernel.weights.data(), taps, vertical.data(), rowBytes);
+      filterColumnsScalar(vertical.data(), width, components, kernel, horizontal.data(), level.width);
+    }
+
+    if (!options.srgb)
+    {
+      if (options.simd)
+        encodeLinearSimd(horizontal.data(), outputRowBytes, output);
+      else
+        encodeLinearScalar(horizontal.data(), outputRowBytes, output);
+      continue;
+    }
+    for (size_t i = 0; i < outputRowBytes; i += components)
+      for (uint32_t c = 0; c < components; c++)
+      {
+        float value = std::clamp(horizontal[i + c], 0.0f, 1.0f);
+        output[i + c] = int32_t(c) == alphaChannel(components) ? uint8_t(value * 255.0f + 0.5f)
+                                                               : lookup.linearToSrgb[int32_t(value * 4095.0f + 0.5f)];
+      }
+  }
+}
+
+MipLevel downsampleLevel(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t components,
+                         const MipmapOptions& options, const Kernel& kernel)
+{
+  MipLevel level = {std::max(width / 2, 1u), std::max(height / 2, 1u), {}};
+  level.pixels.resize(size_t(level.width) * level.height * components);
+
+  // small levels are not worth starting threads for
+  uint32_t threads = std::clamp(level.height / 32, 1u, std::max(options.threads, 1u));
+  uint32_t rowsPerThread = (level.height + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (uint32_t first = rowsPerThread; first < level.height; first += rowsPerThread)
+    workers.emplace_back(downsampleRows, pixels, width, height, components, std::ref(level), first,
+                         std::min(first + rowsPerThread, level.height), std::cref(kernel), std::cref(options));
+  downsampleRows(pixels, width, height, components, level, 0, std::min(rowsPerThread, level.height), kernel, options);
+  for (std::thread& worker : workers)
+    worker.join();
+  return level;
+}
+}
+
+MipLevel downsample(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t components,
+                    const MipmapOptions& options)
+{
+  return downsampleLevel(pixels, width, height, components, options, makeKernel(options.filter));
+}
+
+std::vector<MipLevel> generateMipmaps(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t components,
+                                      const MipmapOptions& options)
+{
+  Kernel kernel = makeKernel(options.filter);
+  std::vector<MipLevel> levels;
+  while (width > 1 || height > 1)
+  {
+    levels.push_back(downsampleLevel(pixels, width, height, components, options, kernel));
+    pixels = levels.back().pixels.data();
+    width = levels.back().width;
+    height = levels.back().height;
+  }
+  return levels;
+}
+
+const char* mipmapInstructionSet(const MipmapOptions& options)
+{
+#if defined(MIPMAP_SSE2)
+  return options.avx2 && hasAvx2() ? "AVX2" : "SSE2";
+#elif defined(MIPMAP_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
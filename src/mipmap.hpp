@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter
+{
+  // averages each 2x2 block, like glGenerateMipmap on most drivers
+  Box,
+  // windowed sinc filters spanning 12 source pixels; sharper than a box without its aliasing
+  Kaiser,
+  Lanczos,
+};
+
+struct MipmapOptions
+{
+  MipFilter filter = MipFilter::Box;
+  // filter color channels in linear light instead of on their encoded values; alpha is always filtered as stored
+  bool srgb = false;
+  // threads splitting the rows of each level, including the caller
+  uint32_t threads = 1;
+  // false runs the scalar reference kernels, for benchmarking and checking the vector ones
+  bool simd = true;
+  // false keeps x86-64 to its SSE2 kernels where AVX2 is available, so both can be checked against the scalar ones
+  bool avx2 = true;
+};
+
+struct MipLevel
+{
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint8_t> pixels;
+};
+
+// Halves a tightly packed 8-bit image with 1 to 4 components. Odd sizes round down and the edges are clamped.
+MipLevel downsample(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t components,
+                    const MipmapOptions& options = {});
+// Builds every level below the given one, down to 1x1; each level is filtered from the one above it
+std::vector<MipLevel> generateMipmaps(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t components,
+                                      const MipmapOptions& options = {});
+// name of the SIMD instruction set the vector kernels use on this machine with these options
+const char* mipmapInstructionSet(const MipmapOptions& options = {});
@@ -0,0 +1,88 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+// A bounded lock-free queue for any number of producers and consumers. Each cell carries a sequence number that
+// tells a producer or consumer whether the cell is ready for it, so the only shared writes are one compare-exchange
+// on the head or tail per operation.
+template <typename T>
+class MpmcQueue
+{
+public:
+  // capacity is rounded up to a power of two
+  MpmcQueue(size_t capacity)
+    : mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1), cells(std::make_unique<Cell[]>(this->mask + 1))
+  {
+    for (size_t i = 0; i <= this->mask; i++)
+      this->cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  MpmcQueue(const MpmcQueue&) = delete;
+  MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+  // returns false without moving from value if the queue is full
+  bool push(T&& value)
+  {
+    size_t position = this->tail.load(std::memory_order_relaxed);
+    while (true)
+    {
+      Cell& cell = this->cells[position & this->mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position);
+      if (difference == 0)
+      {
+        if (this->tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          cell.value = std::move(value);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (difference < 0)
+        return false;
+      else
+        position = this->tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::optional<T> pop()
+  {
+    size_t position = this->head.load(std::memory_order_relaxed);
+    while (true)
+    {
+      Cell& cell = this->cells[position & this->mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position + 1);
+      if (difference == 0)
+      {
+        if (this->head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          std::optional<T> result(std::move(cell.value));
+          cell.sequence.store(position + this->mask + 1, std::memory_order_release);
+          return result;
+        }
+      }
+      else if (difference < 0)
+        return std::nullopt;
+      else
+        position = this->head.load(std::memory_order_relaxed);
+    }
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  const size_t mask;
+  std::unique_ptr<Cell[]> cells;
+  // producers and consumers each hammer one index; keep them on separate cache lines
+  alignas(64) std::atomic<size_t> tail = 0;
+  alignas(64) std::atomic<size_t> head = 0;
+};
@@ -0,0 +1,106 @@
+#include "program_cache.hpp"
+#include "hash.hpp"
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <glad/glad.h>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t MAGIC = 0x4250474c; // "LGPB"
+constexpr uint32_t VERSION = 1;
+
+struct Header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t length;
+  uint64_t checksum;
+};
+}
+
+uint64_t ProgramCache::key(std::string_view vertexSource, std::string_view fragmentSource)
+{
+  // a driver update can change the binary format without changing the format enum, so include its identity
+  uint64_t hash = fnv1a(vertexSource);
+  hash = fnv1a(std::string_view("\0", 1), hash);
+  hash = fnv1a(fragmentSource, hash);
+  hash = fnv1a((const char*)glGetString(GL_RENDERER), hash);
+  hash = fnv1a((const char*)glGetString(GL_VERSION), hash);
+  return hash;
+}
+
+bool ProgramCache::load(uint32_t program, uint64_t key)
+{
+  std::ifstream file(path(key), std::ios::binary);
+  if (!file)
+    return false;
+
+  Header header;
+  if (!file.read((char*)&header, sizeof(header)) || header.magic != MAGIC || header.version != VERSION || header.key != key)
+    return false;
+
+  std::vector<char> binary(header.length);
+  if (!file.read(binary.data(), binary.size()) || fnv1a(std::string_view(binary.data(), binary.size())) != header.checksum)
+    return false;
+
+  glProgramBinary(program, header.format, binary.data(), binary.size());
+  int32_t linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked)
+  {
+    // the driver no longer accepts this binary, drop it so the next launch does not retry
+    std::error_code error;
+    std::filesystem::remove(path(key), error);
+    return false;
+  }
+  return true;
+}
+
+void ProgramCache::store(uint32_t program, uint64_t key)
+{
+  int32_t formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  if (formats == 0)
+    return;
+
+  int32_t length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  std::vector<char> binary(length);
+  uint32_t format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+
+  std::error_code error;
+  std::filesystem::create_directories(directory(), error);
+  if (error)
+  {
+    std::cout << std::format("Failed to create program cache directory {}: {}", directory().string(), error.message()) << std::endl;
+    return;
+  }
+
+  Header header = {MAGIC, VERSION, key, format, uint32_t(length), fnv1a(std::string_view(binary.data(), length))};
+  std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+  file.write((const char*)&header, sizeof(header));
+  file.write(binary.data(), length);
+}
+
+std::filesystem::path ProgramCache::directory()
+{
+  if (const char* cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome)
+    return std::filesystem::path(cacheHome) / "learn-opengl" / "programs";
+  if (const char* home = std::getenv("HOME"); home && *home)
+    return std::filesystem::path(home) / ".cache" / "learn-opengl" / "programs";
+  return std::filesystem::path(".cache") / "programs";
+}
+
+std::filesystem::path ProgramCache::path(uint64_t key)
+{
+  return directory() / std::format("{:016x}.bin", key);
+}
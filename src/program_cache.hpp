@@ -0,0 +1,26 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+// On-disk cache of linked program binaries, keyed by the shader sources and the driver that built them
+class ProgramCache
+{
+public:
+  static uint64_t key(std::string_view vertexSource, std::string_view fragmentSource);
+
+  // replaces the program's contents with a cached binary; returns false on a miss or if the driver rejects it
+  static bool load(uint32_t program, uint64_t key);
+  // program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+  static void store(uint32_t program, uint64_t key);
+
+  static inline uint32_t hits = 0;
+  static inline uint32_t misses = 0;
+  static inline std::chrono::duration<double, std::milli> loadTime;
+  static inline std::chrono::duration<double, std::milli> compileTime;
+
+private:
+  static std::filesystem::path directory();
+  static std::filesystem::path path(uint64_t key);
+};
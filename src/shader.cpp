@@ -1,99 +1,707 @@
 #include "shader.hpp"
+#include "hash.hpp"
+#include "json.hpp"
+#include "program_cache.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
 #include <format>
 #include <fstream>
 #include <glad/glad.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <thread>
 
-Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath)
+namespace
 {
-  this->id = glCreateProgram();
-  uint32_t vert = this->compile(GL_VERTEX_SHADER, vertexPath);
-  uint32_t frag = this->compile(GL_FRAGMENT_SHADER, fragmentPath);
+using Clock = std::chrono::high_resolution_clock;
 
-  glAttachShader(this->id, vert);
-  glAttachShader(this->id, frag);
-  glLinkProgram(this->id);
-  glValidateProgram(this->id);
+struct RegisteredUniform
+{
+  UniformName name;
+  uint32_t type;
+};
+
+std::vector<RegisteredUniform>& uniformRegistry()
+{
+  static std::vector<RegisteredUniform> registry;
+  return registry;
+}
+
+bool typesCompatible(uint32_t declared, uint32_t active)
+{
+  if (declared == active)
+    return true;
+  // samplers are set through their texture unit index
+  if (declared == GL_INT)
+    switch (active)
+    {
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+      return true;
+    }
+  return false;
+}
+
+// whether a block comment is still open at the end of this line, given whether one was at its start
+bool endsInComment(std::string_view line, bool open)
+{
+  for (size_t i = 0; i + 1 < line.size(); i++)
+    if (open && line.substr(i, 2) == "*/")
+    {
+      open = false;
+      i++;
+    }
+    else if (!open && line.substr(i, 2) == "//")
+      break;
+    else if (!open && line.substr(i, 2) == "/*")
+    {
+      open = true;
+      i++;
+    }
+  return open;
+}
+}
 
-  glDeleteShader(vert);
-  glDeleteShader(frag);
+uint32_t registerUniform(UniformName name, uint32_t type)
+{
+  std::vector<RegisteredUniform>& registry = uniformRegistry();
+  for (uint32_t i = 0; i < registry.size(); i++)
+    if (registry[i].name.hash == name.hash && registry[i].name.name == name.name && registry[i].type == type)
+      return i;
+  registry.push_back({name, type});
+  return registry.size() - 1;
+}
+
+Shader::Shader(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines)
+  : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines)
+{
+  this->build();
 }
 
 Shader::~Shader()
 {
-  glDeleteProgram(this->id);
+  this->discardBuild();
+  if (this->id)
+    this->deleteProgram(this->id);
+}
+
+void Shader::reload(Clock::time_point requested)
+{
+  // an edit that lands mid-compile restarts the build with the newest sources
+  this->discardBuild();
+  this->reloadRequested = requested;
+  this->build();
+}
+
+bool Shader::uses(const std::filesystem::path& path) const
+{
+  std::filesystem::path normal = path.lexically_normal();
+  for (const std::filesystem::path& dependency : this->dependencies)
+    if (dependency == normal)
+      return true;
+  return false;
+}
+
+bool Shader::poll()
+{
+  if (!this->building)
+    return true;
+
+  if (GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile)
+  {
+    int32_t complete = 0;
+    glGetProgramiv(this->building, GL_COMPLETION_STATUS_KHR, &complete);
+    if (!complete)
+      return false;
+  }
+
+  Clock::time_point start = Clock::now();
+  std::string error = compileLog(this->vert, this->vertexPath) + compileLog(this->frag, this->fragmentPath);
+  if (error.empty())
+    error = this->linkLog();
+
+  glDetachShader(this->building, this->vert);
+  glDetachShader(this->building, this->frag);
+  glDeleteShader(this->vert);
+  glDeleteShader(this->frag);
+  this->vert = 0;
+  this->frag = 0;
+
+  if (error.empty())
+  {
+    glValidateProgram(this->building);
+    // the binary cache is keyed by GLSL source, which a SPIR-V program was not built from
+    if (!this->buildingReflection.spirv)
+      ProgramCache::store(this->building, this->cacheKey);
+    this->finishBuild();
+  }
+  else
+    this->failBuild(error);
+
+  ProgramCache::compileTime += Clock::now() - start;
+  return true;
+}
+
+bool Shader::ready()
+{
+  this->poll();
+  return this->id != 0;
+}
+
+void Shader::wait()
+{
+  // without a completion query, poll() finishes synchronously
+  while (!this->poll())
+    std::this_thread::yield();
 }
 
 void Shader::use()
 {
+  if (boundProgram == this->id)
+    return;
   glUseProgram(this->id);
+  boundProgram = this->id;
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+void Shader::bindUniformBlock(std::string_view name, uint32_t binding)
 {
-  glUniform1i(glGetUniformLocation(this->id, name.c_str()), (int32_t)value);
+  this->uniformBlockBindings.emplace_back(name, binding);
+  if (this->id)
+    this->applyBlockBindings();
 }
 
-void Shader::setInt(const std::string& name, int32_t value) const
+void Shader::bindStorageBlock(std::string_view name, uint32_t binding)
 {
-  glUniform1i(glGetUniformLocation(this->id, name.c_str()), value);
+  this->storageBlockBindings.emplace_back(name, binding);
+  if (this->id)
+    this->applyBlockBindings();
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+UniformHandle Shader::findUniform(std::string_view name) const
 {
-  glUniform1f(glGetUniformLocation(this->id, name.c_str()), value);
+  return this->findUniform(name, fnv1a(name));
 }
 
-void Shader::setMat4(const std::string& name, glm::mat4 value) const
+UniformHandle Shader::findUniform(std::string_view name, uint64_t hash) const
 {
-  glUniformMatrix4fv(glGetUniformLocation(this->id, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+  if (this->buckets.empty())
+    return -1;
+
+  size_t mask = this->buckets.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask)
+  {
+    UniformHandle handle = this->buckets[i];
+    if (handle < 0)
+      return -1;
+    const UniformSlot& slot = this->uniforms[handle];
+    if (slot.hash == hash && slot.name == name)
+      return slot.canonical;
+  }
 }
 
-void Shader::setVec3(const std::string& name, float x, float y, float z) const
+void Shader::setBool(std::string_view name, bool value) const
 {
-  glUniform3f(glGetUniformLocation(this->id, name.c_str()), x, y, z);
+  this->setBool(this->findUniform(name), value);
 }
 
-void Shader::setVec3(const std::string& name, glm::vec3 value) const
+void Shader::setInt(std::string_view name, int32_t value) const
 {
-  glUniform3fv(glGetUniformLocation(this->id, name.c_str()), 1, glm::value_ptr(value));
+  this->setInt(this->findUniform(name), value);
 }
 
-void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
+void Shader::setFloat(std::string_view name, float value) const
 {
-  glUniform4f(glGetUniformLocation(this->id, name.c_str()), x, y, z, w);
+  this->setFloat(this->findUniform(name), value);
 }
 
-void Shader::setVec4(const std::string& name, glm::vec4 value) const
+void Shader::setMat4(std::string_view name, glm::mat4 value) const
 {
-  glUniform4fv(glGetUniformLocation(this->id, name.c_str()), 1, glm::value_ptr(value));
+  this->setMat4(this->findUniform(name), value);
 }
 
-uint32_t Shader::compile(uint32_t type, const std::string& filename)
+void Shader::setVec3(std::string_view name, float x, float y, float z) const
+{
+  this->setVec3(this->findUniform(name), x, y, z);
+}
+
+void Shader::setVec3(std::string_view name, glm::vec3 value) const
+{
+  this->setVec3(this->findUniform(name), value);
+}
+
+void Shader::setVec4(std::string_view name, float x, float y, float z, float w) const
+{
+  this->setVec4(this->findUniform(name), x, y, z, w);
+}
+
+void Shader::setVec4(std::string_view name, glm::vec4 value) const
+{
+  this->setVec4(this->findUniform(name), value);
+}
+
+void Shader::setBool(UniformHandle handle, bool value) const
+{
+  this->setInt(handle, (int32_t)value);
+}
+
+void Shader::setInt(UniformHandle handle, int32_t value) const
+{
+  if (this->changed(handle, &value, sizeof(value)))
+    glUniform1i(this->uniforms[handle].location, value);
+}
+
+void Shader::setFloat(UniformHandle handle, float value) const
+{
+  if (this->changed(handle, &value, sizeof(value)))
+    glUniform1f(this->uniforms[handle].location, value);
+}
+
+void Shader::setMat4(UniformHandle handle, glm::mat4 value) const
+{
+  if (this->changed(handle, glm::value_ptr(value), sizeof(value)))
+    glUniformMatrix4fv(this->uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setVec3(UniformHandle handle, float x, float y, float z) const
+{
+  this->setVec3(handle, glm::vec3(x, y, z));
+}
+
+void Shader::setVec3(UniformHandle handle, glm::vec3 value) const
+{
+  if (this->changed(handle, glm::value_ptr(value), sizeof(value)))
+    glUniform3fv(this->uniforms[handle].location, 1, glm::value_ptr(value));
+}
+
+void Shader::setVec4(UniformHandle handle, float x, float y, float z, float w) const
+{
+  this->setVec4(handle, glm::vec4(x, y, z, w));
+}
+
+void Shader::setVec4(UniformHandle handle, glm::vec4 value) const
+{
+  if (this->changed(handle, glm::value_ptr(value), sizeof(value)))
+    glUniform4fv(this->uniforms[handle].location, 1, glm::value_ptr(value));
+}
+
+bool Shader::changed(UniformHandle handle, const void* value, size_t size) const
+{
+  if (handle < 0)
+    return false;
+
+  const UniformSlot& slot = this->uniforms[handle];
+  assert(size <= sizeof(slot.shadow));
+  if (slot.shadowValid && std::memcmp(slot.shadow, value, size) == 0)
+  {
+    uniformStats.skipped++;
+    return false;
+  }
+
+  std::memcpy(slot.shadow, value, size);
+  slot.shadowValid = true;
+  uniformStats.uploaded++;
+  return true;
+}
+
+std::string Shader::readFile(const std::filesystem::path& filename)
 {
   std::stringstream buffer;
   buffer << std::ifstream(filename).rdbuf();
-  std::string source = buffer.str();
+  return buffer.str();
+}
+
+std::string Shader::preprocess(const std::filesystem::path& path, size_t stageStart)
+{
+  std::istringstream source(readFile(path));
+  uint32_t sourceIndex = this->dependencies.size();
+  bool root = sourceIndex == stageStart;
+  this->dependencies.push_back(path.lexically_normal());
+
+  // included files number their lines from 1 under their own source index, so errors point into them
+  std::string output = root ? "" : std::format("#line 1 {}\n", sourceIndex);
+  std::string line;
+  bool inComment = false;
+  for (uint32_t lineNumber = 1; std::getline(source, line); lineNumber++)
+  {
+    std::string_view directive = line;
+    directive.remove_prefix(std::min(directive.find_first_not_of(" \t"), directive.size()));
+    // a line starting inside a block comment holds no directives
+    bool commented = inComment;
+    inComment = endsInComment(line, inComment);
+
+    if (!commented && directive.starts_with("#include"))
+    {
+      size_t open = directive.find('"');
+      size_t close = directive.find('"', open + 1);
+      if (open == std::string_view::npos || close == std::string_view::npos)
+      {
+        output += std::format("#error malformed include\n");
+        continue;
+      }
 
+      std::filesystem::path include = (path.parent_path() / directive.substr(open + 1, close - open - 1)).lexically_normal();
+      // every file is included at most once per stage
+      bool included = false;
+      for (size_t i = stageStart; i < this->dependencies.size(); i++)
+        included |= this->dependencies[i] == include;
+      if (!included && !std::filesystem::exists(include))
+        output += std::format("#error cannot open include file \"{}\"\n", include.string());
+      else if (!included)
+        output += this->preprocess(include, stageStart);
+      output += std::format("#line {} {}\n", lineNumber + 1, sourceIndex);
+      continue;
+    }
+
+    output += line;
+    output += '\n';
+
+    // defines go straight after #version, which must stay the first directive
+    if (root && !commented && directive.starts_with("#version"))
+    {
+      for (const auto& [name, value] : this->defines)
+        output += std::format("#define {} {}\n", name, value);
+      output += std::format("#line {} {}\n", lineNumber + 1, sourceIndex);
+    }
+  }
+  return output;
+}
+
+void Shader::build()
+{
+  Clock::time_point start = Clock::now();
+
+  this->dependencies.clear();
+  std::string vertexSource = this->preprocess(this->vertexPath, this->dependencies.size());
+  std::string fragmentSource = this->preprocess(this->fragmentPath, this->dependencies.size());
+  this->cacheKey = ProgramCache::key(vertexSource, fragmentSource);
+
+  this->buildingReflection = {};
+  this->building = glCreateProgram();
+  if (ProgramCache::load(this->building, this->cacheKey))
+  {
+    ProgramCache::hits++;
+    ProgramCache::loadTime += Clock::now() - start;
+    this->finishBuild();
+    return;
+  }
+
+  if (this->buildSpirv())
+  {
+    ProgramCache::misses++;
+    ProgramCache::compileTime += Clock::now() - start;
+    return;
+  }
+
+  // queue the compile and link without querying any status, so drivers with
+  // parallel compilation can work on it in the background
+  this->vert = compile(GL_VERTEX_SHADER, vertexSource);
+  this->frag = compile(GL_FRAGMENT_SHADER, fragmentSource);
+  glAttachShader(this->building, this->vert);
+  glAttachShader(this->building, this->frag);
+  glProgramParameteri(this->building, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(this->building);
+
+  ProgramCache::misses++;
+  ProgramCache::compileTime += Clock::now() - start;
+}
+
+bool Shader::buildSpirv()
+{
+#ifndef SPIRV_DIRECTORY
+  // only defined by shaders/meson.build when glslangValidator is available
+  return false;
+#else
+  if (!GLAD_GL_VERSION_4_6 && !GLAD_GL_ARB_gl_spirv)
+    return false;
+
+  // binaries are named after the source file and the permutation's defines
+  auto binaryPath = [this](const std::string& source, std::string_view extension) {
+    std::string name = std::filesystem::path(source).filename().string();
+    for (const auto& [define, value] : this->defines)
+      name += std::format(".{}={}", define, value);
+    return std::filesystem::path(SPIRV_DIRECTORY) / (name + std::string(extension));
+  };
+
+  // a permutation shaders/meson.build does not list, such as one for a different light count, silently costs the
+  // startup time the binaries save, so say which
+  for (const std::string& source : {this->vertexPath, this->fragmentPath})
+    if (!std::filesystem::exists(binaryPath(source, ".spv")))
+    {
+      std::cout << std::format("No precompiled permutation {}, compiling GLSL",
+                               binaryPath(source, ".spv").filename().string())
+                << std::endl;
+      return false;
+    }
+
+  // an edited source makes the binaries stale until the next build, so fall back to GLSL until then
+  std::error_code error;
+  std::filesystem::file_time_type oldest = std::filesystem::file_time_type::max();
+  for (const std::string& source : {this->vertexPath, this->fragmentPath})
+    for (std::string_view extension : {".spv", ".json"})
+      oldest = std::min(oldest, std::filesystem::last_write_time(binaryPath(source, extension), error));
+  if (error)
+    return false;
+  for (const std::filesystem::path& dependency : this->dependencies)
+    if (std::filesystem::last_write_time(dependency, error) > oldest || error)
+      return false;
+
+  this->vert = glCreateShader(GL_VERTEX_SHADER);
+  this->frag = glCreateShader(GL_FRAGMENT_SHADER);
+  if (!this->loadSpirvStage(this->vert, binaryPath(this->vertexPath, ".spv"), binaryPath(this->vertexPath, ".json"))
+      || !this->loadSpirvStage(this->frag, binaryPath(this->fragmentPath, ".spv"), binaryPath(this->fragmentPath, ".json")))
+  {
+    glDeleteShader(this->vert);
+    glDeleteShader(this->frag);
+    this->vert = 0;
+    this->frag = 0;
+    this->buildingReflection = {};
+    return false;
+  }
+
+  glAttachShader(this->building, this->vert);
+  glAttachShader(this->building, this->frag);
+  glLinkProgram(this->building);
+  this->buildingReflection.spirv = true;
+  return true;
+#endif
+}
+
+bool Shader::loadSpirvStage(uint32_t shader, const std::filesystem::path& binary, const std::filesystem::path& metadata)
+{
+  std::string code = readFile(binary);
+  if (code.empty() || code.size() % 4)
+    return false;
+
+  try
+  {
+    this->buildingReflection.merge(JsonValue::parse(readFile(metadata)));
+  }
+  catch (const std::runtime_error& error)
+  {
+    std::cout << std::format("Ignoring {}: {}", metadata.string(), error.what()) << std::endl;
+    return false;
+  }
+
+  glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, code.data(), code.size());
+  // specializing compiles the module; its status is read with the link status in poll()
+  if (GLAD_GL_VERSION_4_6)
+    glSpecializeShader(shader, "main", 0, nullptr, nullptr);
+  else
+    glSpecializeShaderARB(shader, "main", 0, nullptr, nullptr);
+  return true;
+}
+
+void Shader::finishBuild()
+{
+  uint32_t previous = this->id;
+  this->id = this->building;
+  this->building = 0;
+  if (!this->buildingReflection.spirv)
+    this->buildingReflection = ShaderReflection::query(this->id);
+  std::swap(this->reflection, this->buildingReflection);
+  this->buildUniformTable();
+  std::string error = this->resolveUniforms();
+  if (!error.empty())
+  {
+    // keep serving the previous program and rebuild its tables
+    this->building = this->id;
+    this->id = previous;
+    std::swap(this->reflection, this->buildingReflection);
+    this->buildUniformTable();
+    this->resolveUniforms();
+    this->failBuild(error);
+    return;
+  }
+
+  this->buildingReflection = {};
+  if (previous)
+    this->deleteProgram(previous);
+  this->error.clear();
+  this->applyBlockBindings();
+  if (this->reloadRequested != Clock::time_point())
+  {
+    this->reloadTime = Clock::now() - this->reloadRequested;
+    this->reloadRequested = Clock::time_point();
+    std::cout << std::format("Reloaded {} / {} in {:.2f} ms", this->vertexPath, this->fragmentPath,
+                             this->reloadTime.count())
+              << std::endl;
+  }
+}
+
+void Shader::failBuild(const std::string& message)
+{
+  glDeleteProgram(this->building);
+  this->building = 0;
+  this->buildingReflection = {};
+  this->reloadRequested = Clock::time_point();
+  this->error = message;
+  std::cout << message << std::endl;
+}
+
+void Shader::discardBuild()
+{
+  if (this->vert)
+    glDeleteShader(this->vert);
+  if (this->frag)
+    glDeleteShader(this->frag);
+  if (this->building)
+    glDeleteProgram(this->building);
+  this->vert = 0;
+  this->frag = 0;
+  this->building = 0;
+  this->buildingReflection = {};
+}
+
+void Shader::deleteProgram(uint32_t program)
+{
+  // the name may be reused by the next program, so it must not look bound
+  if (boundProgram == program)
+    boundProgram = 0;
+  glDeleteProgram(program);
+}
+
+uint32_t Shader::compile(uint32_t type, const std::string& source)
+{
   uint32_t id = glCreateShader(type);
   const char *src = source.c_str();
   glShaderSource(id, 1, &src, nullptr);
   glCompileShader(id);
+  return id;
+}
 
+std::string Shader::compileLog(uint32_t shader, const std::string& filename) const
+{
   int result;
-  glGetShaderiv(id, GL_COMPILE_STATUS, &result);
-  if (!result)
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+  if (result)
+    return "";
+
+  int length;
+  glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+  std::string message;
+  message.resize(length);
+  glGetShaderInfoLog(shader, length, &length, message.data());
+  message.resize(length);
+  // #line directives number the sources by their position in the dependency list
+  std::string sources;
+  for (size_t i = 0; i < this->dependencies.size(); i++)
+    sources += std::format("{}{} = {}", i ? ", " : "", i, this->dependencies[i].string());
+  return std::format("Failed to compile shader {} ({}):\n\t{}\n", filename, sources, message);
+}
+
+std::string Shader::linkLog()
+{
+  int result;
+  glGetProgramiv(this->building, GL_LINK_STATUS, &result);
+  if (result)
+    return "";
+
+  int length;
+  glGetProgramiv(this->building, GL_INFO_LOG_LENGTH, &length);
+  std::string message;
+  message.resize(length);
+  glGetProgramInfoLog(this->building, length, &length, message.data());
+  message.resize(length);
+  return std::format("Failed to link program {} / {}:\n\t{}\n", this->vertexPath, this->fragmentPath, message);
+}
+
+void Shader::applyBlockBindings()
+{
+  for (const auto& [name, binding] : this->uniformBlockBindings)
+  {
+    uint32_t index = glGetUniformBlockIndex(this->id, name.c_str());
+    if (index != GL_INVALID_INDEX)
+      glUniformBlockBinding(this->id, index, binding);
+  }
+  for (const auto& [name, binding] : this->storageBlockBindings)
   {
-    int length;
-    glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-    std::string message;
-    message.resize(length);
-    glGetShaderInfoLog(id, length, &length, message.data());
-    std::cout << std::format("Failed to compile shader {}:\n\t{}", filename, message) << std::endl;
-    exit(-1);
+    uint32_t index = glGetProgramResourceIndex(this->id, GL_SHADER_STORAGE_BLOCK, name.c_str());
+    if (index != GL_INVALID_INDEX)
+      glShaderStorageBlockBinding(this->id, index, binding);
   }
+}
 
-  return id;
+void Shader::buildUniformTable()
+{
+  this->uniforms.clear();
+  this->buckets.clear();
+  this->resolved.clear();
+  if (!this->id)
+    return;
+
+  const std::vector<ShaderReflection::Variable>& active = this->reflection.uniforms;
+  this->uniforms.reserve(active.size());
+  // keep the load factor at or below 50% so probe sequences stay short
+  this->buckets.assign(std::bit_ceil(uint32_t(active.size()) * 2 + 1), -1);
+
+  for (const ShaderReflection::Variable& uniform : active)
+  {
+    if (uniform.location < 0)
+      continue;
+
+    UniformHandle first = this->insertUniform(uniform.name, uniform.location, uniform.type);
+    // arrays are reported once as "name[0]"; register every element, and the bare name as another name for the first
+    if (uniform.arraySize > 1 && uniform.name.ends_with("[0]"))
+    {
+      std::string base = uniform.name.substr(0, uniform.name.size() - 3);
+      for (int32_t element = 1; element < uniform.arraySize; element++)
+      {
+        std::string elementName = std::format("{}[{}]", base, element);
+        // SPIR-V programs have no names to look up, but their explicit locations are consecutive
+        int32_t location = this->reflection.spirv ? uniform.location + element
+                                                  : glGetUniformLocation(this->id, elementName.c_str());
+        this->insertUniform(elementName, location, uniform.type);
+      }
+      this->insertUniform(base, uniform.location, uniform.type, first);
+    }
+  }
+}
+
+std::string Shader::resolveUniforms()
+{
+  const std::vector<RegisteredUniform>& registry = uniformRegistry();
+  this->resolved.resize(registry.size());
+  for (size_t i = 0; i < registry.size(); i++)
+  {
+    const RegisteredUniform& uniform = registry[i];
+    UniformHandle handle = this->findUniform(uniform.name.name, uniform.name.hash);
+    if (handle >= 0 && !typesCompatible(uniform.type, this->uniforms[handle].type))
+      return std::format("Uniform {} in {} / {} has GLSL type 0x{:x}, but is declared with type 0x{:x}",
+                         uniform.name.name, this->vertexPath, this->fragmentPath, this->uniforms[handle].type,
+                         uniform.type);
+    this->resolved[i] = handle;
+  }
+  return "";
+}
+
+UniformHandle Shader::insertUniform(std::string name, int32_t location, uint32_t type, UniformHandle canonical)
+{
+  UniformHandle handle = this->uniforms.size();
+  this->uniforms.push_back({std::move(name), 0, location, type, canonical < 0 ? handle : canonical, {}, false});
+  this->uniforms.back().hash = fnv1a(this->uniforms.back().name);
+
+  // array elements can outgrow the initial estimate; rebuild the index at double size
+  if (this->uniforms.size() * 2 > this->buckets.size())
+  {
+    this->buckets.assign(this->buckets.size() * 2, -1);
+    for (size_t i = 0; i + 1 < this->uniforms.size(); i++)
+      this->indexUniform(UniformHandle(i));
+  }
+  this->indexUniform(handle);
+  return handle;
+}
+
+void Shader::indexUniform(UniformHandle handle)
+{
+  size_t mask = this->buckets.size() - 1;
+  size_t bucket = this->uniforms[handle].hash & mask;
+  while (this->buckets[bucket] >= 0)
+    bucket = (bucket + 1) & mask;
+  this->buckets[bucket] = handle;
 }
@@ -1,25 +1,205 @@
 #pragma once
+#include "hash.hpp"
+#include "shader_reflection.hpp"
+#include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <filesystem>
+#include <glad/glad.h>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <glm/glm.hpp>
 
+// Index into a shader's uniform table, or -1 if the uniform is not active
+using UniformHandle = int32_t;
+
+// Preprocessor definitions injected after #version, in order
+using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+// A uniform name whose hash is computed at compile time
+struct UniformName
+{
+  template <size_t N>
+  consteval UniformName(const char (&str)[N]) : name(str, N - 1), hash(fnv1a(name)) {}
+
+  std::string_view name;
+  uint64_t hash;
+};
+
+// GLSL type that a C++ uniform type must match
+template <typename T> struct GlslType;
+template <> struct GlslType<bool> { static constexpr uint32_t value = GL_BOOL; };
+template <> struct GlslType<int32_t> { static constexpr uint32_t value = GL_INT; };
+template <> struct GlslType<float> { static constexpr uint32_t value = GL_FLOAT; };
+template <> struct GlslType<glm::vec3> { static constexpr uint32_t value = GL_FLOAT_VEC3; };
+template <> struct GlslType<glm::vec4> { static constexpr uint32_t value = GL_FLOAT_VEC4; };
+template <> struct GlslType<glm::mat4> { static constexpr uint32_t value = GL_FLOAT_MAT4; };
+
+// Adds a typed uniform to the process-wide list that every Shader resolves after linking
+uint32_t registerUniform(UniformName name, uint32_t type);
+
+// A typed uniform handle. Declare these at namespace scope so they are registered before any Shader is linked.
+template <typename T>
+class Uniform
+{
+public:
+  Uniform(UniformName name) : index(registerUniform(name, GlslType<T>::value)) {}
+
+  uint32_t index;
+};
+
 class Shader {
 public:
-  Shader(const std::string &vertexPath, const std::string &fragmentPath);
+  using Clock = std::chrono::high_resolution_clock;
+
+  // starts compiling and linking without waiting for the driver; check ready() before use
+  Shader(const std::string &vertexPath, const std::string &fragmentPath, const ShaderDefines& defines = {});
   ~Shader();
 
+  // rebuilds the program from its source files; the current program stays in use until the new one links
+  void reload(Clock::time_point requested = Clock::now());
+  // whether path is one of the program's sources or their includes
+  bool uses(const std::filesystem::path& path) const;
+
+  // finishes an in-flight build once the driver is done with it, without blocking when parallel compilation is
+  // available; returns true when no build is in flight
+  bool poll();
+  // polls, then returns whether there is a linked program to draw with
+  bool ready();
+  // blocks until the in-flight build has finished
+  void wait();
+
   void use();
-  void setBool(const std::string& name, bool value) const;
-  void setInt(const std::string& name, int32_t value) const;
-  void setFloat(const std::string& name, float value) const;
 
-  void setMat4(const std::string& name, glm::mat4 value) const;
-  void setVec3(const std::string& name, float x, float y, float z) const;
-  void setVec3(const std::string& name, glm::vec3 value) const;
-  void setVec4(const std::string& name, float x, float y, float z, float w) const;
-  void setVec4(const std::string& name, glm::vec4 value) const;
+  // attaches the named uniform block to a fixed binding point, if the program uses it
+  void bindUniformBlock(std::string_view name, uint32_t binding);
+  // attaches the named shader storage block to a fixed binding point, if the program uses it
+  void bindStorageBlock(std::string_view name, uint32_t binding);
 
-  uint32_t id;
+  // the interface of the current program, refreshed whenever a build links
+  const ShaderReflection& reflect() const { return this->reflection; }
+
+  // resolves a uniform name against the table built at link time, without querying the driver
+  UniformHandle findUniform(std::string_view name) const;
+
+  void setBool(std::string_view name, bool value) const;
+  void setInt(std::string_view name, int32_t value) const;
+  void setFloat(std::string_view name, float value) const;
+
+  void setMat4(std::string_view name, glm::mat4 value) const;
+  void setVec3(std::string_view name, float x, float y, float z) const;
+  void setVec3(std::string_view name, glm::vec3 value) const;
+  void setVec4(std::string_view name, float x, float y, float z, float w) const;
+  void setVec4(std::string_view name, glm::vec4 value) const;
+
+  void setBool(UniformHandle handle, bool value) const;
+  void setInt(UniformHandle handle, int32_t value) const;
+  void setFloat(UniformHandle handle, float value) const;
+
+  void setMat4(UniformHandle handle, glm::mat4 value) const;
+  void setVec3(UniformHandle handle, float x, float y, float z) const;
+  void setVec3(UniformHandle handle, glm::vec3 value) const;
+  void setVec4(UniformHandle handle, float x, float y, float z, float w) const;
+  void setVec4(UniformHandle handle, glm::vec4 value) const;
+
+  template <typename T>
+  void set(const Uniform<T>& uniform, const T& value) const
+  {
+    assert(uniform.index < this->resolved.size());
+    UniformHandle handle = this->resolved[uniform.index];
+    if constexpr (std::is_same_v<T, bool>)
+      this->setBool(handle, value);
+    else if constexpr (std::is_same_v<T, int32_t>)
+      this->setInt(handle, value);
+    else if constexpr (std::is_same_v<T, float>)
+      this->setFloat(handle, value);
+    else if constexpr (std::is_same_v<T, glm::vec3>)
+      this->setVec3(handle, value);
+    else if constexpr (std::is_same_v<T, glm::vec4>)
+      this->setVec4(handle, value);
+    else if constexpr (std::is_same_v<T, glm::mat4>)
+      this->setMat4(handle, value);
+  }
+
+  // uniform uploads issued and skipped as redundant; the caller resets these once per frame
+  struct UniformStats
+  {
+    uint32_t uploaded;
+    uint32_t skipped;
+  };
+  static inline UniformStats uniformStats = {};
+
+  uint32_t id = 0;
+  std::string vertexPath;
+  std::string fragmentPath;
+  ShaderDefines defines;
+  // message from the last failed build, empty once a build succeeds
+  std::string error;
+  std::chrono::duration<double, std::milli> reloadTime{};
 private:
-  uint32_t compile(uint32_t type, const std::string &source);
+  struct UniformSlot
+  {
+    std::string name;
+    uint64_t hash;
+    int32_t location;
+    uint32_t type;
+    // the slot lookups return: itself, or for an array's bare name the slot of its first element, so both names
+    // share one shadow copy
+    UniformHandle canonical;
+    // last value uploaded, compared before every set so unchanged values skip the driver call
+    alignas(16) mutable uint8_t shadow[sizeof(glm::mat4)];
+    mutable bool shadowValid;
+  };
+
+  static std::string readFile(const std::filesystem::path& filename);
+  // resolves #include "file" relative to the including file and injects defines into the root source. Directives on
+  // lines that start inside a block comment are left as they are.
+  std::string preprocess(const std::filesystem::path& path, size_t stageStart);
+  static uint32_t compile(uint32_t type, const std::string& source);
+  std::string compileLog(uint32_t shader, const std::string& filename) const;
+  std::string linkLog();
+  void build();
+  // starts building from the precompiled SPIR-V of this permutation; returns false if there is none or it is older
+  // than any of the sources
+  bool buildSpirv();
+  bool loadSpirvStage(uint32_t shader, const std::filesystem::path& binary, const std::filesystem::path& metadata);
+  void finishBuild();
+  void failBuild(const std::string& message);
+  void discardBuild();
+  void deleteProgram(uint32_t program);
+  // updates the slot's shadow copy; returns false if the handle is invalid or the value is unchanged
+  bool changed(UniformHandle handle, const void* value, size_t size) const;
+  void applyBlockBindings();
+  UniformHandle findUniform(std::string_view name, uint64_t hash) const;
+  void buildUniformTable();
+  std::string resolveUniforms();
+  // returns the new slot's handle; canonical < 0 makes the slot its own
+  UniformHandle insertUniform(std::string name, int32_t location, uint32_t type, UniformHandle canonical = -1);
+  void indexUniform(UniformHandle handle);
+
+  std::vector<UniformSlot> uniforms;
+  // open-addressed index into uniforms, sized to a power of two
+  std::vector<UniformHandle> buckets;
+  // registered Uniform<T> index -> handle in this program
+  std::vector<UniformHandle> resolved;
+
+  std::vector<std::pair<std::string, uint32_t>> uniformBlockBindings;
+  std::vector<std::pair<std::string, uint32_t>> storageBlockBindings;
+
+  // every file read by the last build, sources first
+  std::vector<std::filesystem::path> dependencies;
+  uint64_t cacheKey = 0;
+  // program and shader objects of the build in flight, if any
+  uint32_t building = 0;
+  uint32_t vert = 0;
+  uint32_t frag = 0;
+  ShaderReflection reflection;
+  ShaderReflection buildingReflection;
+  Clock::time_point reloadRequested;
+
+  // program last passed to glUseProgram through use()
+  static inline uint32_t boundProgram = 0;
 };
@@ -0,0 +1,43 @@
+#include "shader_compiler.hpp"
+#include "program_cache.hpp"
+#include <algorithm>
+#include <format>
+#include <glad/glad.h>
+#include <iostream>
+
+ShaderCompiler::ShaderCompiler()
+  : start(std::chrono::high_resolution_clock::now())
+{
+  this->parallel = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+  if (GLAD_GL_KHR_parallel_shader_compile)
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+  else if (GLAD_GL_ARB_parallel_shader_compile)
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+void ShaderCompiler::submit(Shader& shader)
+{
+  this->pending.push_back(&shader);
+}
+
+bool ShaderCompiler::poll()
+{
+  if (this->pending.empty())
+    return true;
+
+  std::erase_if(this->pending, [](Shader* shader) { return shader->poll(); });
+  if (!this->pending.empty())
+    return false;
+  // later submissions are reloads, which report their own timing
+  if (this->reported)
+    return true;
+  this->reported = true;
+
+  std::chrono::duration<double, std::milli> wallTime = std::chrono::high_resolution_clock::now() - this->start;
+  std::cout << std::format("Shaders ready after {:.2f} ms ({} compile); program cache: {} hits, {} misses, "
+                           "{:.2f} ms loading, {:.2f} ms compiling on the GL thread",
+                           wallTime.count(), this->parallel ? "parallel" : "serial", ProgramCache::hits,
+                           ProgramCache::misses, ProgramCache::loadTime.count(), ProgramCache::compileTime.count())
+            << std::endl;
+  return true;
+}
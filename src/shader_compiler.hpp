@@ -0,0 +1,22 @@
+#pragma once
+#include "shader.hpp"
+#include <chrono>
+#include <vector>
+
+// Tracks programs that are still compiling so the GL thread can keep working while the driver builds them
+class ShaderCompiler
+{
+public:
+  // asks the driver for as many compiler threads as it can use
+  ShaderCompiler();
+
+  void submit(Shader& shader);
+  // finishes every program the driver is done with; returns true once nothing is pending
+  bool poll();
+
+  bool parallel;
+  std::vector<Shader*> pending;
+private:
+  std::chrono::high_resolution_clock::time_point start;
+  bool reported = false;
+};
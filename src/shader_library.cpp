@@ -0,0 +1,57 @@
+#include "shader_library.hpp"
+#include "hash.hpp"
+
+ShaderLibrary::ShaderLibrary(ShaderCompiler& compiler)
+  : compiler(compiler)
+{
+}
+
+Shader& ShaderLibrary::get(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines)
+{
+  uint64_t key = ShaderLibrary::key(vertexPath, fragmentPath, defines);
+  if (auto it = this->permutations.find(key); it != this->permutations.end())
+    return *it->second;
+
+  Shader& shader = *this->shaders.emplace_back(std::make_unique<Shader>(vertexPath, fragmentPath, defines));
+  this->permutations.emplace(key, &shader);
+  for (const auto& [name, binding] : this->uniformBlockBindings)
+    shader.bindUniformBlock(name, binding);
+  for (const auto& [name, binding] : this->storageBlockBindings)
+    shader.bindStorageBlock(name, binding);
+  this->compiler.submit(shader);
+  return shader;
+}
+
+void ShaderLibrary::bindUniformBlock(const std::string& name, uint32_t binding)
+{
+  this->uniformBlockBindings.emplace_back(name, binding);
+  for (const std::unique_ptr<Shader>& shader : this->shaders)
+    shader->bindUniformBlock(name, binding);
+}
+
+void ShaderLibrary::bindStorageBlock(const std::string& name, uint32_t binding)
+{
+  this->storageBlockBindings.emplace_back(name, binding);
+  for (const std::unique_ptr<Shader>& shader : this->shaders)
+    shader->bindStorageBlock(name, binding);
+}
+
+void ShaderLibrary::reload(const std::filesystem::path& path, Shader::Clock::time_point requested)
+{
+  for (const std::unique_ptr<Shader>& shader : this->shaders)
+    if (shader->uses(path))
+    {
+      shader->reload(requested);
+      this->compiler.submit(*shader);
+    }
+}
+
+uint64_t ShaderLibrary::key(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines)
+{
+  // separators keep ("ab", "c") and ("a", "bc") apart
+  constexpr std::string_view separator("\0", 1);
+  uint64_t hash = fnv1a(fragmentPath, fnv1a(separator, fnv1a(vertexPath)));
+  for (const auto& [name, value] : defines)
+    hash = fnv1a(value, fnv1a(separator, fnv1a(name, fnv1a(separator, hash))));
+  return hash;
+}
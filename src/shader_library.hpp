@@ -0,0 +1,30 @@
+#pragma once
+#include "shader.hpp"
+#include "shader_compiler.hpp"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Owns every program permutation, so each combination of sources and defines is compiled once
+class ShaderLibrary
+{
+public:
+  ShaderLibrary(ShaderCompiler& compiler);
+
+  // returns the permutation for these sources and defines, submitting it to the compiler on first use
+  Shader& get(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines = {});
+  // attaches a block to a fixed binding point in every permutation, including ones created later
+  void bindUniformBlock(const std::string& name, uint32_t binding);
+  void bindStorageBlock(const std::string& name, uint32_t binding);
+  // rebuilds every permutation that reads path
+  void reload(const std::filesystem::path& path, Shader::Clock::time_point requested);
+
+  std::vector<std::unique_ptr<Shader>> shaders;
+private:
+  static uint64_t key(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines);
+
+  ShaderCompiler& compiler;
+  std::unordered_map<uint64_t, Shader*> permutations;
+  std::vector<std::pair<std::string, uint32_t>> uniformBlockBindings;
+  std::vector<std::pair<std::string, uint32_t>> storageBlockBindings;
+};
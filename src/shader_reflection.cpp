@@ -0,0 +1,335 @@
+#include "shader_reflection.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <glad/glad.h>
+
+namespace
+{
+struct TypeInfo
+{
+  std::string_view name;
+  uint32_t type;
+  int32_t components;
+  bool integer;
+};
+
+constexpr TypeInfo types[] = {
+  {"bool", GL_BOOL, 1, true},
+  {"int", GL_INT, 1, true},
+  {"uint", GL_UNSIGNED_INT, 1, true},
+  {"float", GL_FLOAT, 1, false},
+  {"vec2", GL_FLOAT_VEC2, 2, false},
+  {"vec3", GL_FLOAT_VEC3, 3, false},
+  {"vec4", GL_FLOAT_VEC4, 4, false},
+  {"ivec2", GL_INT_VEC2, 2, true},
+  {"ivec3", GL_INT_VEC3, 3, true},
+  {"ivec4", GL_INT_VEC4, 4, true},
+  {"uvec2", GL_UNSIGNED_INT_VEC2, 2, true},
+  {"uvec3", GL_UNSIGNED_INT_VEC3, 3, true},
+  {"uvec4", GL_UNSIGNED_INT_VEC4, 4, true},
+  {"mat2", GL_FLOAT_MAT2, 4, false},
+  {"mat3", GL_FLOAT_MAT3, 9, false},
+  {"mat4", GL_FLOAT_MAT4, 16, false},
+  {"sampler2D", GL_SAMPLER_2D, 1, true},
+  {"sampler2DArray", GL_SAMPLER_2D_ARRAY, 1, true},
+  {"sampler3D", GL_SAMPLER_3D, 1, true},
+  {"samplerCube", GL_SAMPLER_CUBE, 1, true},
+};
+
+const TypeInfo* typeInfo(uint32_t type)
+{
+  for (const TypeInfo& info : types)
+    if (info.type == type)
+      return &info;
+  return nullptr;
+}
+
+// bytes one vertex attribute occupies in its buffer
+int32_t attributeBytes(uint32_t type, int32_t components)
+{
+  switch (type)
+  {
+  case GL_BYTE:
+  case GL_UNSIGNED_BYTE:
+    return components;
+  case GL_SHORT:
+  case GL_UNSIGNED_SHORT:
+  case GL_HALF_FLOAT:
+    return components * 2;
+  case GL_INT_2_10_10_10_REV:
+  case GL_UNSIGNED_INT_2_10_10_10_REV:
+    return 4;
+  case GL_DOUBLE:
+    return components * 8;
+  default:
+    return components * 4;
+  }
+}
+
+std::string resourceName(uint32_t program, uint32_t interface, uint32_t index, int32_t length)
+{
+  std::string name(std::max(length, 1), '\0');
+  glGetProgramResourceName(program, interface, index, name.size(), &length, name.data());
+  name.resize(length);
+  return name;
+}
+
+std::vector<ShaderReflection::Block> queryBlocks(uint32_t program, uint32_t interface)
+{
+  int32_t count = 0;
+  glGetProgramInterfaceiv(program, interface, GL_ACTIVE_RESOURCES, &count);
+
+  std::vector<ShaderReflection::Block> blocks;
+  for (int32_t i = 0; i < count; i++)
+  {
+    constexpr uint32_t properties[] = {GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE};
+    int32_t values[std::size(properties)] = {};
+    glGetProgramResourceiv(program, interface, i, std::size(properties), properties, std::size(values), nullptr, values);
+    blocks.push_back({resourceName(program, interface, i, values[0]), values[1], values[2], {}});
+  }
+  return blocks;
+}
+
+std::vector<ShaderReflection::Variable> readVariables(const JsonValue& variables)
+{
+  std::vector<ShaderReflection::Variable> result;
+  for (const JsonValue& variable : variables.array())
+    result.push_back({std::string(variable["name"].string()), glslType(variable["type"].string()),
+                      int32_t(variable["location"].number(-1)), int32_t(variable["arraySize"].number(1))});
+  return result;
+}
+
+std::vector<ShaderReflection::Block> readBlocks(const JsonValue& blocks)
+{
+  std::vector<ShaderReflection::Block> result;
+  for (const JsonValue& block : blocks.array())
+  {
+    ShaderReflection::Block& added = result.emplace_back();
+    added.name = block["name"].string();
+    added.binding = block["binding"].number(-1);
+    added.size = block["size"].number();
+    for (const JsonValue& member : block["members"].array())
+      added.members.push_back({std::string(member["name"].string()), glslType(member["type"].string()),
+                               int32_t(member["offset"].number()), int32_t(member["arraySize"].number(1)),
+                               int32_t(member["arrayStride"].number()), int32_t(member["matrixStride"].number()),
+                               int32_t(member["topLevelArrayStride"].number())});
+  }
+  return result;
+}
+
+// both stages list the resources they share; keep the first copy
+template <typename T>
+void mergeByName(std::vector<T>& into, std::vector<T> from)
+{
+  for (T& item : from)
+    if (std::none_of(into.begin(), into.end(), [&](const T& existing) { return existing.name == item.name; }))
+      into.push_back(std::move(item));
+}
+
+template <typename T>
+const T* findByName(const std::vector<T>& items, std::string_view name)
+{
+  for (const T& item : items)
+    if (item.name == name)
+      return &item;
+  return nullptr;
+}
+}
+
+ShaderReflection ShaderReflection::query(uint32_t program)
+{
+  ShaderReflection result;
+  result.uniformBlocks = queryBlocks(program, GL_UNIFORM_BLOCK);
+  result.storageBlocks = queryBlocks(program, GL_SHADER_STORAGE_BLOCK);
+
+  int32_t count = 0;
+  glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+  for (int32_t i = 0; i < count; i++)
+  {
+    constexpr uint32_t properties[] = {GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE, GL_BLOCK_INDEX,
+                                       GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE};
+    int32_t values[std::size(properties)] = {};
+    glGetProgramResourceiv(program, GL_UNIFORM, i, std::size(properties), properties, std::size(values), nullptr, values);
+    std::string name = resourceName(program, GL_UNIFORM, i, values[0]);
+    // uniforms inside blocks have no location and are set through their buffer
+    if (values[4] < 0)
+      result.uniforms.push_back({std::move(name), uint32_t(values[1]), values[2], values[3]});
+    else if (size_t(values[4]) < result.uniformBlocks.size())
+      result.uniformBlocks[values[4]].members.push_back(
+        {std::move(name), uint32_t(values[1]), values[5], values[3], values[6], values[7], 0});
+  }
+
+  glGetProgramInterfaceiv(program, GL_BUFFER_VARIABLE, GL_ACTIVE_RESOURCES, &count);
+  for (int32_t i = 0; i < count; i++)
+  {
+    constexpr uint32_t properties[] = {GL_NAME_LENGTH, GL_TYPE, GL_BLOCK_INDEX, GL_OFFSET, GL_ARRAY_SIZE,
+                                       GL_ARRAY_STRIDE, GL_MATRIX_STRIDE, GL_TOP_LEVEL_ARRAY_STRIDE};
+    int32_t values[std::size(properties)] = {};
+    glGetProgramResourceiv(program, GL_BUFFER_VARIABLE, i, std::size(properties), properties, std::size(values),
+                           nullptr, values);
+    if (values[2] >= 0 && size_t(values[2]) < result.storageBlocks.size())
+      result.storageBlocks[values[2]].members.push_back({resourceName(program, GL_BUFFER_VARIABLE, i, values[0]),
+                                                         uint32_t(values[1]), values[3], values[4], values[5],
+                                                         values[6], values[7]});
+  }
+
+  glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+  for (int32_t i = 0; i < count; i++)
+  {
+    constexpr uint32_t properties[] = {GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE};
+    int32_t values[std::size(properties)] = {};
+    glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, std::size(properties), properties, std::size(values), nullptr,
+                           values);
+    // built-ins such as gl_VertexID have no location and are not fed by the vertex array
+    if (values[2] >= 0)
+      result.inputs.push_back({resourceName(program, GL_PROGRAM_INPUT, i, values[0]), uint32_t(values[1]), values[2],
+                               values[3]});
+  }
+  return result;
+}
+
+void ShaderReflection::merge(const JsonValue& stage)
+{
+  this->spirv = true;
+  mergeByName(this->uniforms, readVariables(stage["uniforms"]));
+  mergeByName(this->uniformBlocks, readBlocks(stage["uniformBlocks"]));
+  mergeByName(this->storageBlocks, readBlocks(stage["storageBlocks"]));
+  // only the vertex stage's inputs are fed by the vertex array
+  if (stage["stage"].string() == "vert")
+    mergeByName(this->inputs, readVariables(stage["inputs"]));
+}
+
+const ShaderReflection::BlockMember* ShaderReflection::Block::findMember(std::string_view name) const
+{
+  return findByName(this->members, name);
+}
+
+const ShaderReflection::Variable* ShaderReflection::findUniform(std::string_view name) const
+{
+  return findByName(this->uniforms, name);
+}
+
+const ShaderReflection::Variable* ShaderReflection::findInput(std::string_view name) const
+{
+  return findByName(this->inputs, name);
+}
+
+const ShaderReflection::Block* ShaderReflection::findUniformBlock(std::string_view name) const
+{
+  return findByName(this->uniformBlocks, name);
+}
+
+const ShaderReflection::Block* ShaderReflection::findStorageBlock(std::string_view name) const
+{
+  return findByName(this->storageBlocks, name);
+}
+
+uint32_t glslType(std::string_view name)
+{
+  for (const TypeInfo& info : types)
+    if (info.name == name)
+      return info.type;
+  return 0;
+}
+
+std::string_view glslTypeName(uint32_t type)
+{
+  const TypeInfo* info = typeInfo(type);
+  return info ? info->name : "unknown";
+}
+
+std::vector<std::string> validateVertexArray(uint32_t vao, const ShaderReflection& reflection)
+{
+  struct Attribute
+  {
+    const ShaderReflection::Variable* input;
+    int32_t buffer;
+    int32_t stride;
+    int64_t offset;
+    int32_t bytes;
+  };
+
+  int32_t previous = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+  glBindVertexArray(vao);
+
+  std::vector<std::string> problems;
+  std::vector<Attribute> attributes;
+  for (const ShaderReflection::Variable& input : reflection.inputs)
+  {
+    uint32_t location = input.location;
+    int32_t enabled = 0;
+    glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+    if (!enabled)
+    {
+      problems.push_back(std::format("Input {} (location {}) has no enabled attribute in vertex array {}", input.name,
+                                     location, vao));
+      continue;
+    }
+
+    int32_t components = 0;
+    int32_t type = 0;
+    int32_t stride = 0;
+    int32_t integer = 0;
+    int32_t buffer = 0;
+    void* pointer = nullptr;
+    glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &components);
+    glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+    glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+    glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &integer);
+    glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+    glGetVertexAttribPointerv(location, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+
+    // matrix inputs span several locations; only their first column is checked. Packed attributes always have four
+    // components, and inputs may read fewer of them.
+    const TypeInfo* info = typeInfo(input.type);
+    bool packed = type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV;
+    if (info && info->components <= 4 && components != info->components && !(packed && info->components < 4))
+      problems.push_back(std::format("Input {} ({}) reads {} components, but attribute {} supplies {}", input.name,
+                                     info->name, info->components, location, components));
+    if (info && info->integer != bool(integer))
+      problems.push_back(std::format("Input {} ({}) is {}, but attribute {} is set up with {}", input.name, info->name,
+                                     info->integer ? "integer" : "floating point", location,
+                                     integer ? "glVertexAttribIPointer" : "glVertexAttribPointer"));
+
+    int32_t bytes = attributeBytes(type, components);
+    attributes.push_back({&input, buffer, stride ? stride : bytes, int64_t(reinterpret_cast<intptr_t>(pointer)), bytes});
+  }
+
+  glBindVertexArray(previous);
+
+  // interleaved attributes in one buffer must fit in the stride without overlapping
+  for (size_t i = 0; i < attributes.size(); i++)
+  {
+    const Attribute& a = attributes[i];
+    if (a.offset % a.stride + a.bytes > a.stride)
+      problems.push_back(std::format("Attribute {} ({}) ends at byte {}, past its stride of {}", a.input->location,
+                                     a.input->name, a.offset % a.stride + a.bytes, a.stride));
+    for (size_t j = i + 1; j < attributes.size(); j++)
+    {
+      const Attribute& b = attributes[j];
+      if (a.buffer == b.buffer && a.stride == b.stride && a.offset < b.offset + b.bytes && b.offset < a.offset + a.bytes)
+        problems.push_back(std::format("Attributes {} ({}) and {} ({}) overlap in buffer {}", a.input->location,
+                                       a.input->name, b.input->location, b.input->name, a.buffer));
+    }
+  }
+  return problems;
+}
+
+std::vector<std::string> validateBlockLayout(const ShaderReflection::Block& block,
+                                             const std::vector<std::pair<std::string_view, size_t>>& offsets)
+{
+  std::vector<std::string> problems;
+  for (const auto& [name, offset] : offsets)
+  {
+    const ShaderReflection::BlockMember* member = block.findMember(name);
+    if (!member)
+      problems.push_back(std::format("Block {} has no member {}", block.name, name));
+    else if (size_t(member->offset) != offset)
+      problems.push_back(std::format("Block {} member {} is at offset {}, but the C++ struct has it at {}", block.name,
+                                     name, member->offset, offset));
+  }
+  return problems;
+}
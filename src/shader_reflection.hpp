@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class JsonValue;
+
+// The active interface of a linked program: default-block uniforms, uniform and storage blocks, and vertex inputs
+struct ShaderReflection
+{
+  // a default-block uniform or a vertex input; arrays of basic types are listed once as "name[0]"
+  struct Variable
+  {
+    std::string name;
+    uint32_t type;
+    int32_t location;
+    int32_t arraySize;
+  };
+
+  // a leaf member of a block, named the way GL names it, e.g. "pointLights[0].position"
+  struct BlockMember
+  {
+    std::string name;
+    uint32_t type;
+    int32_t offset;
+    int32_t arraySize;
+    int32_t arrayStride;
+    int32_t matrixStride;
+    // distance between elements of an outermost array of structs in a storage block, 0 otherwise
+    int32_t topLevelArrayStride;
+  };
+
+  struct Block
+  {
+    std::string name;
+    int32_t binding;
+    // bytes needed for the block, counting a trailing runtime-sized array as empty
+    int32_t size;
+    std::vector<BlockMember> members;
+
+    const BlockMember* findMember(std::string_view name) const;
+  };
+
+  // reads the active resources of a linked GLSL program through the program interface queries
+  static ShaderReflection query(uint32_t program);
+  // adds one stage's reflection data as written by scripts/compile_spirv.py; SPIR-V programs carry no names, so
+  // they are reflected from this instead of the driver
+  void merge(const JsonValue& stage);
+
+  const Variable* findUniform(std::string_view name) const;
+  const Variable* findInput(std::string_view name) const;
+  const Block* findUniformBlock(std::string_view name) const;
+  const Block* findStorageBlock(std::string_view name) const;
+
+  bool spirv = false;
+  std::vector<Variable> uniforms;
+  std::vector<Block> uniformBlocks;
+  std::vector<Block> storageBlocks;
+  std::vector<Variable> inputs;
+};
+
+// GL type enum for a GLSL type name, or 0 if it is not known
+uint32_t glslType(std::string_view name);
+// GLSL type name for a GL type enum, for messages
+std::string_view glslTypeName(uint32_t type);
+
+// Checks the enabled attributes of a vertex array against a program's vertex inputs. Returns a description of every
+// mismatch, or nothing if the program can draw with it.
+std::vector<std::string> validateVertexArray(uint32_t vao, const ShaderReflection& reflection);
+
+// Checks a block's reflected member offsets against the C++ struct that mirrors it, given as (member, offsetof)
+std::vector<std::string> validateBlockLayout(const ShaderReflection::Block& block,
+                                             const std::vector<std::pair<std::string_view, size_t>>& offsets);
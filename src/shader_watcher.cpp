@@ -0,0 +1,92 @@
+#include "shader_watcher.hpp"
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <utility>
+
+ShaderWatcher::ShaderWatcher(const std::filesystem::path& directory)
+  : directory(directory)
+{
+  this->inotify = inotify_init1(IN_CLOEXEC);
+  if (this->inotify < 0)
+  {
+    std::cout << std::format("Shader hot reload disabled: inotify_init1 failed: {}", std::strerror(errno)) << std::endl;
+    return;
+  }
+
+  // editors either rewrite the file in place or rename a temporary over it
+  if (inotify_add_watch(this->inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+  {
+    std::cout << std::format("Shader hot reload disabled: cannot watch {}: {}", directory.string(), std::strerror(errno))
+              << std::endl;
+    close(this->inotify);
+    this->inotify = -1;
+    return;
+  }
+
+  this->stopEvent = eventfd(0, EFD_CLOEXEC);
+  this->thread = std::thread(&ShaderWatcher::run, this);
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+  if (this->thread.joinable())
+  {
+    uint64_t value = 1;
+    (void)!write(this->stopEvent, &value, sizeof(value));
+    this->thread.join();
+  }
+  if (this->stopEvent >= 0)
+    close(this->stopEvent);
+  if (this->inotify >= 0)
+    close(this->inotify);
+}
+
+std::vector<ShaderWatcher::Change> ShaderWatcher::takeChanges()
+{
+  std::lock_guard lock(this->mutex);
+  return std::exchange(this->changes, {});
+}
+
+void ShaderWatcher::run()
+{
+  alignas(inotify_event) char buffer[4096];
+  pollfd fds[] = {{this->inotify, POLLIN, 0}, {this->stopEvent, POLLIN, 0}};
+  while (true)
+  {
+    if (poll(fds, 2, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+
+    ssize_t length = read(this->inotify, buffer, sizeof(buffer));
+    if (length <= 0)
+      continue;
+
+    auto now = std::chrono::high_resolution_clock::now();
+    std::lock_guard lock(this->mutex);
+    for (char* ptr = buffer; ptr < buffer + length;)
+    {
+      const inotify_event* event = (const inotify_event*)ptr;
+      ptr += sizeof(inotify_event) + event->len;
+      if (!event->len)
+        continue;
+
+      std::filesystem::path path = this->directory / event->name;
+      bool queued = false;
+      for (const Change& change : this->changes)
+        queued |= change.path == path;
+      if (!queued)
+        this->changes.push_back({path, now});
+    }
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Watches a shader directory with inotify on a background thread and queues the files that change
+class ShaderWatcher
+{
+public:
+  struct Change
+  {
+    std::filesystem::path path;
+    std::chrono::high_resolution_clock::time_point time;
+  };
+
+  ShaderWatcher(const std::filesystem::path& directory);
+  ShaderWatcher(const ShaderWatcher&) = delete;
+  ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+  ~ShaderWatcher();
+
+  // returns and clears the files changed since the last call, each listed once
+  std::vector<Change> takeChanges();
+
+private:
+  void run();
+
+  std::filesystem::path directory;
+  int inotify = -1;
+  int stopEvent = -1;
+  std::thread thread;
+  std::mutex mutex;
+  std::vector<Change> changes;
+};
@@ -0,0 +1,83 @@
+#include "staging_ring.hpp"
+#include <cstring>
+#include <glad/glad.h>
+
+namespace
+{
+// keeps every write aligned for any pixel or block type
+constexpr uint64_t alignment = 16;
+}
+
+StagingRing::StagingRing(size_t size)
+  : size(size)
+{
+  glGenBuffers(1, &this->buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+  if (GLAD_GL_ARB_buffer_storage)
+  {
+    // coherent, so writes are visible to the GPU without flushing
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+    this->mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    this->persistent = this->mapped != nullptr;
+  }
+  else
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+StagingRing::~StagingRing()
+{
+  for (const Region& region : this->regions)
+    glDeleteSync((GLsync)region.fence);
+  // deleting a buffer unmaps it
+  glDeleteBuffers(1, &this->buffer);
+}
+
+std::optional<size_t> StagingRing::write(const void* data, size_t size)
+{
+  this->retire();
+
+  // a write never wraps around the end, so skip to the start when it would
+  uint64_t start = (this->head + alignment - 1) / alignment * alignment;
+  if (start % this->size + size > this->size)
+    start = (start / this->size + 1) * this->size;
+  if (start + size - this->tail > this->size)
+    return std::nullopt;
+
+  size_t offset = start % this->size;
+  if (this->persistent)
+    std::memcpy(this->mapped + offset, data, size);
+  else
+  {
+    // the fences already guarantee the GPU is done with this range
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+    void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size,
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    std::memcpy(target, data, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  }
+  this->head = start + size;
+  return offset;
+}
+
+void StagingRing::fence()
+{
+  if (this->head == this->fenced)
+    return;
+  this->regions.push_back({this->head, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+  this->fenced = this->head;
+}
+
+void StagingRing::retire()
+{
+  while (!this->regions.empty())
+  {
+    GLenum status = glClientWaitSync((GLsync)this->regions.front().fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    glDeleteSync((GLsync)this->regions.front().fence);
+    this->tail = this->regions.front().end;
+    this->regions.pop_front();
+  }
+}
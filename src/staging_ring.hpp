@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+// A pixel unpack buffer used as a ring of staging memory for texture uploads. It stays mapped for its whole life
+// when GL_ARB_buffer_storage is available, and is mapped per write without synchronization otherwise. Space is
+// reused once the fence placed after the commands reading it has signaled, so writing never waits on the GPU.
+class StagingRing
+{
+public:
+  StagingRing(size_t size);
+  StagingRing(const StagingRing&) = delete;
+  StagingRing& operator=(const StagingRing&) = delete;
+  ~StagingRing();
+
+  // copies data into the ring and returns its offset in the buffer, or nothing if the GPU still holds too much of
+  // the ring to fit it without waiting
+  std::optional<size_t> write(const void* data, size_t size);
+  // marks everything written so far as read by the commands issued up to now
+  void fence();
+
+  uint32_t buffer = 0;
+  const size_t size;
+  bool persistent = false;
+
+private:
+  struct Region
+  {
+    // position in bytes ever written, not wrapped
+    uint64_t end;
+    void* fence;
+  };
+
+  // frees regions whose fences have signaled
+  void retire();
+
+  uint8_t* mapped = nullptr;
+  uint64_t head = 0;
+  uint64_t tail = 0;
+  uint64_t fenced = 0;
+  std::deque<Region> regions;
+};
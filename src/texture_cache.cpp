@@ -0,0 +1,105 @@
+#include "texture_cache.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <string_view>
+#include <utility>
+
+TextureCache::Handle::Handle(TextureCache* cache, Entry* entry)
+  : cache(cache), entry(entry)
+{
+  this->entry->references++;
+}
+
+TextureCache::Handle::Handle(const Handle& other)
+  : cache(other.cache), entry(other.entry)
+{
+  if (this->entry)
+    this->entry->references++;
+}
+
+TextureCache::Handle::Handle(Handle&& other)
+  : cache(std::exchange(other.cache, nullptr)), entry(std::exchange(other.entry, nullptr))
+{
+}
+
+TextureCache::Handle& TextureCache::Handle::operator=(Handle other)
+{
+  std::swap(this->cache, other.cache);
+  std::swap(this->entry, other.entry);
+  return *this;
+}
+
+TextureCache::Handle::~Handle()
+{
+  if (this->entry)
+    this->cache->release(this->entry);
+}
+
+uint32_t TextureCache::Handle::id() const
+{
+  return this->entry ? this->entry->texture : 0;
+}
+
+bool TextureCache::Handle::loaded() const
+{
+  return this->entry && this->entry->loaded;
+}
+
+TextureCache::TextureCache(TextureLoader& loader)
+  : loader(loader)
+{
+}
+
+TextureCache::Handle TextureCache::get(const std::filesystem::path& path, const TextureSampler& sampler)
+{
+  // "assets/./a.png" and "assets/a.png" are the same file
+  std::string canonical = std::filesystem::weakly_canonical(path).string();
+  uint64_t key = TextureCache::key(canonical, sampler);
+  if (auto it = this->index.find(key); it != this->index.end())
+    return Handle(this, it->second);
+
+  uint32_t texture = this->loader.load(canonical, sampler);
+  Entry& entry = *this->entries.emplace_back(std::make_unique<Entry>(Entry{canonical, sampler, key, texture, 0, 4, false}));
+  this->index.emplace(key, &entry);
+  this->textures.emplace(texture, &entry);
+  return Handle(this, &entry);
+}
+
+void TextureCache::poll()
+{
+  this->loader.poll();
+  for (const TextureLoader::Upload& upload : this->loader.takeUploads())
+    if (auto it = this->textures.find(upload.texture); it != this->textures.end())
+    {
+      it->second->residentBytes = upload.bytes;
+      it->second->loaded = true;
+    }
+}
+
+size_t TextureCache::residentBytes() const
+{
+  size_t total = 0;
+  for (const std::unique_ptr<Entry>& entry : this->entries)
+    total += entry->residentBytes;
+  return total;
+}
+
+uint64_t TextureCache::key(const std::string& path, const TextureSampler& sampler)
+{
+  uint64_t hash = fnv1a(path);
+  // field by field, as the struct's padding is uninitialized
+  for (int32_t value : {sampler.wrapS, sampler.wrapT, sampler.minFilter, sampler.magFilter, int32_t(sampler.srgb)})
+    hash = fnv1a(std::string_view((const char*)&value, sizeof(value)), hash);
+  return hash;
+}
+
+void TextureCache::release(Entry* entry)
+{
+  if (--entry->references > 0)
+    return;
+
+  this->loader.unload(entry->texture);
+  this->index.erase(entry->key);
+  this->textures.erase(entry->texture);
+  std::erase_if(this->entries, [&](const std::unique_ptr<Entry>& existing) { return existing.get() == entry; });
+}
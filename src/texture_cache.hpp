@@ -0,0 +1,73 @@
+#pragma once
+#include "texture_loader.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Shares textures between everything that samples the same file with the same sampler state. Each texture is
+// loaded once and deleted when its last handle goes away.
+class TextureCache
+{
+public:
+  struct Entry
+  {
+    std::string path;
+    TextureSampler sampler;
+    uint64_t key;
+    uint32_t texture;
+    uint32_t references;
+    // bytes uploaded for the texture and its mips; the placeholder until the image arrives
+    size_t residentBytes;
+    // whether the image has replaced the placeholder
+    bool loaded;
+  };
+
+  // A counted reference to a cached texture. Handles must not outlive the cache that issued them.
+  class Handle
+  {
+  public:
+    Handle() = default;
+    Handle(const Handle& other);
+    Handle(Handle&& other);
+    Handle& operator=(Handle other);
+    ~Handle();
+
+    // the GL texture name, or 0 for an empty handle
+    uint32_t id() const;
+    bool loaded() const;
+    explicit operator bool() const { return this->entry != nullptr; }
+
+  private:
+    friend class TextureCache;
+    Handle(TextureCache* cache, Entry* entry);
+
+    TextureCache* cache = nullptr;
+    Entry* entry = nullptr;
+  };
+
+  TextureCache(TextureLoader& loader);
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+
+  // returns the texture for this file and sampler state, loading it on first use
+  Handle get(const std::filesystem::path& path, const TextureSampler& sampler = {});
+  // uploads finished images and records their sizes; call once per frame on the GL thread
+  void poll();
+
+  size_t residentBytes() const;
+  // identifies a canonical path loaded with a sampler state
+  static uint64_t key(const std::string& path, const TextureSampler& sampler);
+
+  std::vector<std::unique_ptr<Entry>> entries;
+private:
+  void release(Entry* entry);
+
+  TextureLoader& loader;
+  std::unordered_map<uint64_t, Entry*> index;
+  // texture name -> entry, so uploads can be matched back
+  std::unordered_map<uint32_t, Entry*> textures;
+};
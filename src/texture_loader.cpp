@@ -0,0 +1,357 @@
+#include "texture_loader.hpp"
+#include "ktx2.hpp"
+#include <algorithm>
+#include <format>
+#include <glad/glad.h>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+using Clock = std::chrono::high_resolution_clock;
+
+constexpr size_t queueCapacity = 256;
+
+// GL format for a cooked texture, or 0 if the driver cannot sample it. Lighting works on encoded values and decoded
+// images are stored as UNORM, so sRGB files are sampled as stored too; their tag only says the mips were filtered in
+// linear light, as load() does for a sampler with srgb set.
+uint32_t compressedFormat(Ktx2Format format)
+{
+  switch (format)
+  {
+  case Ktx2Format::BC1_RGB_UNORM:
+  case Ktx2Format::BC1_RGB_SRGB:
+    return GLAD_GL_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+  case Ktx2Format::BC3_UNORM:
+  case Ktx2Format::BC3_SRGB:
+    return GLAD_GL_EXT_texture_compression_s3tc ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0;
+  case Ktx2Format::BC5_UNORM:
+    return GL_COMPRESSED_RG_RGTC2;
+  }
+  return 0;
+}
+}
+
+TextureLoader::TextureLoader(const TextureLoaderOptions& options)
+  : jobs(queueCapacity), images(queueCapacity), mipmaps{.filter = options.filter, .simd = options.simd}
+{
+  // leave a core for the GL thread
+  uint32_t count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  for (uint32_t i = 0; i < count; i++)
+    this->workers.emplace_back(&TextureLoader::run, this);
+}
+
+TextureLoader::~TextureLoader()
+{
+  this->stopping = true;
+  this->available.release(this->workers.size());
+  for (std::thread& worker : this->workers)
+    worker.join();
+}
+
+uint32_t TextureLoader::load(const std::string& path, const TextureSampler& sampler)
+{
+  // timing covers each batch of loads, from the first request to the last upload
+  if (this->inFlight.empty())
+  {
+    this->start = Clock::now();
+    this->decodeTime = 0;
+    this->mipmapTime = 0;
+    this->uploadTime = {};
+    this->loaded = 0;
+  }
+
+  std::filesystem::path cooked = cookedPath(path);
+  if (uint32_t texture = cooked.empty() ? 0 : this->loadCooked(cooked, sampler))
+    return texture;
+
+  uint32_t texture = this->createPlaceholder(sampler);
+  Job job = {path, texture, sampler.srgb};
+  while (!this->jobs.push(std::move(job)))
+    std::this_thread::yield();
+  this->available.release();
+  this->inFlight.emplace(texture, false);
+  return texture;
+}
+
+void TextureLoader::unload(uint32_t texture)
+{
+  // a worker or a stream still refers to the name, so it cannot be deleted until poll() next looks at it
+  if (auto it = this->inFlight.find(texture); it != this->inFlight.end())
+    it->second = true;
+  else
+    glDeleteTextures(1, &texture);
+}
+
+bool TextureLoader::poll()
+{
+  while (std::optional<Image> image = this->images.pop())
+  {
+    if (image->pixels)
+    {
+      this->beginStream(std::move(*image));
+      continue;
+    }
+    std::cout << "Texture failed to load at path: " << image->path << std::endl;
+    auto it = this->inFlight.find(image->texture);
+    if (it->second)
+      glDeleteTextures(1, &image->texture);
+    this->inFlight.erase(it);
+    this->loaded++;
+  }
+  this->stream();
+  if (!this->inFlight.empty())
+    return false;
+
+  if (this->loaded > 0)
+  {
+    std::chrono::duration<double, std::milli> wallTime = Clock::now() - this->start;
+    std::chrono::duration<double, std::milli> decodeTime = std::chrono::nanoseconds(this->decodeTime.load());
+    std::chrono::duration<double, std::milli> mipmapTime = std::chrono::nanoseconds(this->mipmapTime.load());
+    std::cout << std::format("Loaded {} textures in {:.2f} ms: {:.2f} ms decoding and {:.2f} ms building mips on {} "
+                             "workers, {:.2f} ms uploading on the GL thread",
+                             this->loaded, wallTime.count(), decodeTime.count(), mipmapTime.count(),
+                             this->workers.size(), this->uploadTime.count())
+              << std::endl;
+    this->loaded = 0;
+  }
+  return true;
+}
+
+std::vector<TextureLoader::Upload> TextureLoader::takeUploads()
+{
+  return std::exchange(this->uploads, {});
+}
+
+uint32_t TextureLoader::pending() const
+{
+  return this->inFlight.size();
+}
+
+std::filesystem::path TextureLoader::cookedPath(const std::string& path)
+{
+#ifdef KTX2_DIRECTORY
+  std::filesystem::path cooked =
+    std::filesystem::path(KTX2_DIRECTORY) / (std::filesystem::path(path).filename().string() + ".ktx2");
+  std::error_code cookedError;
+  std::filesystem::file_time_type cookedTime = std::filesystem::last_write_time(cooked, cookedError);
+  if (cookedError)
+    return {};
+  // a stale file would hide edits to the source image until the next build. Files cooked from several images have
+  // no source of their own, and the build keeps them current.
+  std::error_code sourceError;
+  std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(path, sourceError);
+  if (!sourceError && cookedTime < sourceTime)
+    return {};
+  return cooked;
+#else
+  return {};
+#endif
+}
+
+bool TextureLoader::hasCooked(const std::string& path)
+{
+  std::filesystem::path cooked = cookedPath(path);
+  if (cooked.empty())
+    return false;
+  MappedFile file(cooked);
+  std::optional<Ktx2Image> image = file ? parseKtx2(file.data()) : std::nullopt;
+  return image && compressedFormat(image->format);
+}
+
+uint32_t TextureLoader::loadCooked(const std::filesystem::path& cooked, const TextureSampler& sampler)
+{
+  std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>(cooked);
+  std::optional<Ktx2Image> image = *file ? parseKtx2(file->data()) : std::nullopt;
+  if (!image)
+  {
+    std::cout << std::format("Ignoring malformed texture {}", cooked.string()) << std::endl;
+    return 0;
+  }
+  uint32_t format = compressedFormat(image->format);
+  if (!format)
+    return 0;
+
+  uint32_t texture = this->createPlaceholder(sampler);
+  Stream stream = {texture, 0, format, {}, uint32_t(image->levels.size() - 1), 0, false, 0, {}, nullptr};
+  for (uint32_t level = 0; level < image->levels.size(); level++)
+  {
+    uint32_t height = std::max(image->height >> level, 1u);
+    uint32_t rows = (height + 3) / 4;
+    stream.levels.push_back({image->levels[level], std::max(image->width >> level, 1u), height, rows,
+                             image->levels[level].size() / rows});
+  }
+  // the levels point into the mapping, so it stays open until the upload finishes
+  stream.file = std::move(file);
+  this->streams.push_back(std::move(stream));
+  this->inFlight.emplace(texture, false);
+  return texture;
+}
+
+uint32_t TextureLoader::createPlaceholder(const TextureSampler& sampler)
+{
+  uint32_t texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  const uint8_t placeholder[] = {128, 128, 128, 255};
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+  // the placeholder has no mips, so cap the level range until the real image arrives
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+  return texture;
+}
+
+void TextureLoader::run()
+{
+  while (true)
+  {
+    this->available.acquire();
+    if (this->stopping)
+      return;
+    std::optional<Job> job = this->jobs.pop();
+    if (!job)
+      continue;
+
+    Clock::time_point decodeStart = Clock::now();
+    Image image = {std::move(job->path), job->texture, 0, 0, 0, nullptr, {}};
+    MappedFile file(image.path);
+    DecodedImage decoded = file ? decodeImage(this->decoders, file.data()) : DecodedImage{0, 0, 0, nullptr};
+    image.width = decoded.width;
+    image.height = decoded.height;
+    image.components = decoded.components;
+    image.pixels = std::move(decoded.pixels);
+    Clock::time_point mipmapStart = Clock::now();
+    this->decodeTime += std::chrono::nanoseconds(mipmapStart - decodeStart).count();
+    if (image.pixels)
+    {
+      MipmapOptions mipmaps = this->mipmaps;
+      mipmaps.srgb = job->srgb;
+      image.mips = generateMipmaps(image.pixels.get(), image.width, image.height, image.components, mipmaps);
+      this->mipmapTime += std::chrono::nanoseconds(Clock::now() - mipmapStart).count();
+    }
+
+    while (!this->images.push(std::move(image)))
+    {
+      if (this->stopping)
+        return;
+      std::this_thread::yield();
+    }
+  }
+}
+
+void TextureLoader::beginStream(Image image)
+{
+  uint32_t format = GL_RGB;
+  // sized, so other textures can be allocated with glTexStorage to match and copied into
+  uint32_t internalFormat = GL_RGB8;
+  if (image.components == 1)
+  {
+    format = GL_RED;
+    internalFormat = GL_R8;
+  }
+  else if (image.components == 4)
+  {
+    format = GL_RGBA;
+    internalFormat = GL_RGBA8;
+  }
+
+  Stream stream = {image.texture, format, internalFormat, {}, uint32_t(image.mips.size()), 0, false, 0,
+                   std::move(image), nullptr};
+  const Image& source = stream.image;
+  size_t rowBytes = size_t(source.width) * source.components;
+  stream.levels.push_back({{source.pixels.get(), rowBytes * source.height}, uint32_t(source.width),
+                           uint32_t(source.height), uint32_t(source.height), rowBytes});
+  for (const MipLevel& mip : source.mips)
+    stream.levels.push_back({mip.pixels, mip.width, mip.height, mip.height, size_t(mip.width) * source.components});
+  this->streams.push_back(std::move(stream));
+}
+
+void TextureLoader::stream()
+{
+  std::erase_if(this->streams, [&](const Stream& stream) {
+    auto it = this->inFlight.find(stream.texture);
+    if (!it->second)
+      return false;
+    glDeleteTextures(1, &stream.texture);
+    this->inFlight.erase(it);
+    return true;
+  });
+  if (this->streams.empty())
+    return;
+
+  Clock::time_point uploadStart = Clock::now();
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->staging.buffer);
+  // rows of 1 and 3 component images are not 4 byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  size_t budget = this->uploadBudget;
+  while (budget > 0 && !this->streams.empty())
+  {
+    // the smallest pending level of any texture goes first, so every texture shows something early
+    auto it = std::min_element(this->streams.begin(), this->streams.end(), [](const Stream& a, const Stream& b) {
+      const StreamLevel& left = a.levels[a.level];
+      const StreamLevel& right = b.levels[b.level];
+      return size_t(left.width) * left.height < size_t(right.width) * right.height;
+    });
+    Stream& stream = *it;
+    const StreamLevel& level = stream.levels[stream.level];
+
+    // copying into the ring is the GL thread's only per-byte work, and nothing here maps or waits on a buffer. The
+    // copy is whole rows, bounded by the budget and by a quarter of the ring so a write always fits once the GPU
+    // catches up.
+    size_t limit = std::min(budget, this->staging.size / 4);
+    uint32_t rows = std::clamp<size_t>(limit / level.rowBytes, 1, level.rows - stream.row);
+    size_t size = rows * level.rowBytes;
+    std::optional<size_t> offset = this->staging.write(level.data.data() + stream.row * level.rowBytes, size);
+    if (!offset)
+      break;
+
+    glBindTexture(GL_TEXTURE_2D, stream.texture);
+    if (!stream.allocated)
+    {
+      // replaces the placeholder; sampling is limited to the levels that have arrived
+      glTexStorage2D(GL_TEXTURE_2D, stream.levels.size(), stream.internalFormat, stream.levels[0].width,
+                     stream.levels[0].height);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, stream.levels.size() - 1);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, stream.levels.size() - 1);
+      stream.allocated = true;
+    }
+    if (stream.format)
+      glTexSubImage2D(GL_TEXTURE_2D, stream.level, 0, stream.row, level.width, rows, stream.format, GL_UNSIGNED_BYTE,
+                      (const void*)*offset);
+    else
+    {
+      // the last block row may be cut short by the edge of the level
+      uint32_t y = stream.row * 4;
+      glCompressedTexSubImage2D(GL_TEXTURE_2D, stream.level, 0, y, level.width, std::min(rows * 4, level.height - y),
+                                stream.internalFormat, size, (const void*)*offset);
+    }
+    budget -= std::min(budget, size);
+    stream.bytes += size;
+    stream.row += rows;
+    if (stream.row < level.rows)
+      continue;
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, stream.level);
+    stream.row = 0;
+    if (stream.level > 0)
+    {
+      stream.level--;
+      continue;
+    }
+
+    this->uploads.push_back({stream.texture, stream.bytes});
+    this->inFlight.erase(stream.texture);
+    this->loaded++;
+    this->streams.erase(it);
+  }
+
+  // the ring reuses this frame's space once the copies out of it have finished
+  this->staging.fence();
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  this->uploadTime += Clock::now() - uploadStart;
+}
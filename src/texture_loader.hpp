@@ -0,0 +1,166 @@
+#pragma once
+#include "image_decoder.hpp"
+#include "mapped_file.hpp"
+#include "mipmap.hpp"
+#include "mpmc_queue.hpp"
+#include "staging_ring.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <glad/glad.h>
+#include <memory>
+#include <semaphore>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Wrap and filter state applied to a texture when it is created
+struct TextureSampler
+{
+  int32_t wrapS = GL_REPEAT;
+  int32_t wrapT = GL_REPEAT;
+  int32_t minFilter = GL_LINEAR_MIPMAP_LINEAR;
+  int32_t magFilter = GL_LINEAR;
+  // the image is sRGB encoded color, so its mips are filtered in linear light. Set it for color maps only; data such
+  // as specular intensity is filtered as stored.
+  bool srgb = false;
+
+  bool operator==(const TextureSampler&) const = default;
+};
+
+// How TextureLoader's workers build mip chains. Each worker filters its own images, and whether an image is sRGB comes
+// from the sampler it is loaded with, so neither a thread count nor srgb is set here.
+struct TextureLoaderOptions
+{
+  MipFilter filter = MipFilter::Box;
+  // false runs the scalar reference kernels
+  bool simd = true;
+};
+
+// Decodes images on a pool of worker threads and streams them into immutable texture storage on the GL thread.
+// Textures are usable straight away and show a 1x1 placeholder until their pixels arrive. Workers decode with the
+// fastest ImageDecoder built in for each file and also build its mip chain on the CPU. Images cooked to KTX2 at build
+// time skip decoding and stream their compressed levels straight from the mapped file.
+//
+// Uploads go through a staging ring, smallest mips first, within a per-frame byte budget. A texture samples only its
+// fully uploaded levels while the larger ones arrive over the following frames.
+class TextureLoader
+{
+public:
+  explicit TextureLoader(const TextureLoaderOptions& options = {});
+  TextureLoader(const TextureLoader&) = delete;
+  TextureLoader& operator=(const TextureLoader&) = delete;
+  ~TextureLoader();
+
+  struct Upload
+  {
+    uint32_t texture;
+    // bytes of the uploaded image and its mip chain
+    size_t bytes;
+  };
+
+  // creates the texture and queues its decode; the returned name is valid immediately
+  uint32_t load(const std::string& path, const TextureSampler& sampler = {});
+  // deletes a texture from load(), deferring it until the upload if the image is still decoding
+  void unload(uint32_t texture);
+  // streams up to uploadBudget bytes of the images the workers have finished; call once per frame on the GL thread.
+  // Returns true once nothing is pending.
+  bool poll();
+  // returns and clears the textures poll() has finished uploading since the last call
+  std::vector<Upload> takeUploads();
+
+  // textures queued but not yet fully uploaded
+  uint32_t pending() const;
+  // the KTX2 file load() streams instead of decoding path, or an empty path if there is none or it is stale
+  static std::filesystem::path cookedPath(const std::string& path);
+  // whether load() streams path from a cooked file rather than decoding it: one exists, is current, parses and is in
+  // a format the driver samples. Needs a GL context.
+  static bool hasCooked(const std::string& path);
+
+  // bytes poll() copies to the GPU per call; one row of a level always goes through, so wide levels still progress
+  size_t uploadBudget = 4 << 20;
+
+private:
+  struct Job
+  {
+    std::string path;
+    uint32_t texture;
+    bool srgb;
+  };
+
+  struct Image
+  {
+    std::string path;
+    uint32_t texture;
+    int32_t width;
+    int32_t height;
+    int32_t components;
+    // null if decoding failed
+    std::unique_ptr<uint8_t, PixelsDeleter> pixels;
+    // levels 1 and below
+    std::vector<MipLevel> mips;
+  };
+
+  struct StreamLevel
+  {
+    std::span<const uint8_t> data;
+    uint32_t width;
+    uint32_t height;
+    // rows of pixels, or of 4x4 blocks for compressed levels
+    uint32_t rows;
+    size_t rowBytes;
+  };
+
+  // a texture whose levels are being uploaded
+  struct Stream
+  {
+    uint32_t texture;
+    // pixel format for glTexSubImage2D, or 0 for block-compressed levels
+    uint32_t format;
+    uint32_t internalFormat;
+    // level 0 first, pointing into image or file
+    std::vector<StreamLevel> levels;
+    // the level being uploaded, counting down from the smallest, and the next row of it
+    uint32_t level;
+    uint32_t row;
+    // whether the texture's immutable storage has replaced the placeholder
+    bool allocated;
+    size_t bytes;
+    Image image;
+    std::unique_ptr<MappedFile> file;
+  };
+
+  uint32_t createPlaceholder(const TextureSampler& sampler);
+  void run();
+  // streams a block-compressed texture straight from its mapped KTX2 file; returns 0 if it is malformed or in a
+  // format the driver cannot sample
+  uint32_t loadCooked(const std::filesystem::path& cooked, const TextureSampler& sampler);
+  // queues a decoded image's levels for upload
+  void beginStream(Image image);
+  // uploads as much of the pending streams as the budget and the staging ring allow
+  void stream();
+
+  MpmcQueue<Job> jobs;
+  MpmcQueue<Image> images;
+  // counts queued jobs, so idle workers sleep instead of spinning
+  std::counting_semaphore<> available{0};
+  std::atomic<bool> stopping = false;
+  std::vector<std::thread> workers;
+  // textures queued for decoding or streaming -> whether unload() was called on them meanwhile
+  std::unordered_map<uint32_t, bool> inFlight;
+  std::vector<Stream> streams;
+  StagingRing staging{16 << 20};
+  std::vector<Upload> uploads;
+  const MipmapOptions mipmaps;
+  const std::vector<std::unique_ptr<ImageDecoder>> decoders = availableDecoders();
+
+  // decode time summed across workers, in nanoseconds
+  std::atomic<int64_t> decodeTime = 0;
+  std::atomic<int64_t> mipmapTime = 0;
+  std::chrono::duration<double, std::milli> uploadTime{};
+  std::chrono::high_resolution_clock::time_point start;
+  uint32_t loaded = 0;
+};
@@ -0,0 +1,124 @@
+#include "texture_residency.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+TextureResidency::TextureResidency(size_t budget)
+  : budget(budget)
+{
+}
+
+uint32_t TextureResidency::add(std::vector<size_t> levelBytes, uint32_t resident)
+{
+  uint32_t levels = levelBytes.size();
+  this->textures.push_back({std::move(levelBytes), resident, resident, levels, this->frame});
+  this->peakBytes = std::max(this->peakBytes, this->residentBytes());
+  return this->textures.size() - 1;
+}
+
+void TextureResidency::resize(uint32_t texture, std::vector<size_t> levelBytes)
+{
+  this->textures[texture].levelBytes = std::move(levelBytes);
+  this->peakBytes = std::max(this->peakBytes, this->residentBytes());
+}
+
+void TextureResidency::request(uint32_t texture, uint32_t level)
+{
+  Texture& entry = this->textures[texture];
+  entry.desired = std::min<uint32_t>({entry.desired, level, uint32_t(entry.levelBytes.size() - 1)});
+  entry.lastUse = this->frame;
+}
+
+std::vector<TextureResidency::Change> TextureResidency::update()
+{
+  // levels being loaded back count against the budget already
+  size_t committed = 0;
+  for (uint32_t i = 0; i < this->textures.size(); i++)
+    committed += this->bytes(i, this->textures[i].loading);
+
+  // textures mid-load are left alone; the rest are evicted least recently used first, and textures drawn this frame
+  // only lose levels they did not ask for unless that is not enough
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < this->textures.size(); i++)
+    if (this->textures[i].loading == this->textures[i].resident)
+      order.push_back(i);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    if (this->textures[a].lastUse != this->textures[b].lastUse)
+      return this->textures[a].lastUse < this->textures[b].lastUse;
+    return this->bytes(a, this->textures[a].resident) > this->bytes(b, this->textures[b].resident);
+  });
+
+  std::vector<uint32_t> before(this->textures.size());
+  for (uint32_t i = 0; i < this->textures.size(); i++)
+    before[i] = this->textures[i].resident;
+  for (bool keepRequested : {true, false})
+    for (uint32_t i : order)
+    {
+      Texture& texture = this->textures[i];
+      uint32_t coarsest = texture.levelBytes.size() - 1;
+      uint32_t floor = coarsest;
+      if (keepRequested && texture.lastUse == this->frame)
+        floor = std::min(texture.desired, coarsest);
+      while (committed > this->budget && texture.resident < floor)
+        committed -= texture.levelBytes[texture.resident++];
+    }
+
+  std::vector<Change> changes;
+  for (uint32_t i = 0; i < this->textures.size(); i++)
+    if (this->textures[i].resident != before[i])
+    {
+      this->textures[i].loading = this->textures[i].resident;
+      changes.push_back({i, this->textures[i].resident});
+    }
+
+  // loading back right after evicting would only thrash. Otherwise the most recently used textures load first, as
+  // many of their missing levels as fit.
+  if (changes.empty())
+  {
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return this->textures[a].lastUse > this->textures[b].lastUse;
+    });
+    for (uint32_t i : order)
+    {
+      Texture& texture = this->textures[i];
+      while (texture.loading > texture.desired && committed + texture.levelBytes[texture.loading - 1] <= this->budget)
+        committed += texture.levelBytes[--texture.loading];
+      if (texture.loading != texture.resident)
+        changes.push_back({i, texture.loading});
+    }
+  }
+
+  for (Texture& texture : this->textures)
+    texture.desired = texture.levelBytes.size();
+  this->frame++;
+  return changes;
+}
+
+void TextureResidency::loaded(uint32_t texture)
+{
+  this->textures[texture].resident = this->textures[texture].loading;
+  this->peakBytes = std::max(this->peakBytes, this->residentBytes());
+}
+
+size_t TextureResidency::residentBytes() const
+{
+  size_t total = 0;
+  for (uint32_t i = 0; i < this->textures.size(); i++)
+    total += this->bytes(i, this->textures[i].resident);
+  return total;
+}
+
+size_t TextureResidency::bytes(uint32_t texture, uint32_t level) const
+{
+  const std::vector<size_t>& levelBytes = this->textures[texture].levelBytes;
+  return std::accumulate(levelBytes.begin() + std::min<size_t>(level, levelBytes.size()), levelBytes.end(), size_t(0));
+}
+
+uint32_t TextureResidency::levelForScreenSize(uint32_t textureSize, float screenSize)
+{
+  // each level halves the size, so this is how many halvings bring the texels down to the pixels
+  if (screenSize <= 0.0f)
+    return 31;
+  float level = std::floor(std::log2(float(textureSize) / screenSize));
+  return uint32_t(std::clamp(level, 0.0f, 31.0f));
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decides which mip levels of each texture stay in video memory so that together they fit a budget. Owners register
+// their textures, report every frame the finest level each use needs, and carry out the changes update() returns:
+// the finest levels of the least recently used textures are evicted when over budget, and evicted levels are loaded
+// back once a use needs them and there is room again.
+class TextureResidency
+{
+public:
+  struct Texture
+  {
+    // bytes of each level, finest first
+    std::vector<size_t> levelBytes;
+    // first level in memory; the levels after it are too
+    uint32_t resident;
+    // first level being loaded back, or resident when nothing is
+    uint32_t loading;
+    // finest level requested since the last update(), or the level count if none was
+    uint32_t desired;
+    // frame of the last request
+    uint64_t lastUse;
+  };
+
+  struct Change
+  {
+    uint32_t texture;
+    // the new first level. Coarser than before means the owner frees the levels above it right away; finer means
+    // it starts loading them and calls loaded() once they are all in memory.
+    uint32_t level;
+  };
+
+  TextureResidency(size_t budget);
+
+  // registers a texture whose levels from resident on are in memory, returning its index
+  uint32_t add(std::vector<size_t> levelBytes, uint32_t resident = 0);
+  // updates the level sizes of a texture whose storage changed, like an array that grew
+  void resize(uint32_t texture, std::vector<size_t> levelBytes);
+  // records that something drawn this frame samples the texture from this level on
+  void request(uint32_t texture, uint32_t level);
+  // ends the frame, returning the evictions and loads that keep the textures in use within the budget
+  std::vector<Change> update();
+  // marks the levels a texture was loading as resident
+  void loaded(uint32_t texture);
+
+  // bytes of the levels in memory, not counting ones still loading
+  size_t residentBytes() const;
+  // bytes of a texture's levels from this one on
+  size_t bytes(uint32_t texture, uint32_t level) const;
+  // the level whose texels are closest to one per pixel when a texture this many texels wide covers this many
+  // pixels on screen
+  static uint32_t levelForScreenSize(uint32_t textureSize, float screenSize);
+
+  size_t budget;
+  size_t peakBytes = 0;
+  std::vector<Texture> textures;
+
+private:
+  uint64_t frame = 0;
+};
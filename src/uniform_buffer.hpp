@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <glad/glad.h>
+
+// A uniform buffer holding a single std140 block, attached to a fixed binding point
+template <typename T>
+class UniformBuffer
+{
+public:
+  UniformBuffer(uint32_t binding) : binding(binding)
+  {
+    glGenBuffers(1, &this->id);
+    glBindBuffer(GL_UNIFORM_BUFFER, this->id);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, this->binding, this->id);
+  }
+  UniformBuffer(const UniformBuffer&) = delete;
+  UniformBuffer& operator=(const UniformBuffer&) = delete;
+  ~UniformBuffer()
+  {
+    glDeleteBuffers(1, &this->id);
+  }
+
+  void update(const T& value)
+  {
+    glBindBuffer(GL_UNIFORM_BUFFER, this->id);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+  }
+
+  uint32_t id;
+  uint32_t binding;
+};
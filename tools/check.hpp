@@ -0,0 +1,53 @@
+#pragma once
+#include "mesh.hpp"
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <numbers>
+#include <string>
+
+// What the GL-free checks under tools/ share. Each check() that fails is printed and counted, and main() returns
+// checksPassed(), so meson test sees a failure as exit code 1.
+
+inline uint32_t failures = 0;
+
+inline void check(bool condition, const std::string& message)
+{
+  if (condition)
+    return;
+  std::cout << std::format("FAILED: {}", message) << std::endl;
+  failures++;
+}
+
+// the exit code for the checks so far, printing what passed if they all did
+inline int checksPassed(const char* what)
+{
+  if (failures)
+    return 1;
+  std::cout << std::format("{} checks passed", what) << std::endl;
+  return 0;
+}
+
+// a UV sphere of this radius around centre, with smooth normals, as 2 * segments^2 triangles
+inline MeshData sphere(glm::vec3 centre, float radius, uint32_t segments)
+{
+  MeshData mesh;
+  for (uint32_t y = 0; y <= segments; y++)
+    for (uint32_t x = 0; x <= segments; x++)
+    {
+      glm::vec2 uv(float(x) / segments, float(y) / segments);
+      float theta = uv.x * 2.0f * std::numbers::pi_v<float>;
+      float phi = uv.y * std::numbers::pi_v<float>;
+      glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+      mesh.vertices.push_back({centre + normal * radius, normal, uv});
+    }
+  for (uint32_t y = 0; y < segments; y++)
+    for (uint32_t x = 0; x < segments; x++)
+    {
+      uint32_t a = y * (segments + 1) + x;
+      uint32_t c = a + segments + 1;
+      mesh.indices.insert(mesh.indices.end(), {a, a + 1, c + 1, a, c + 1, c});
+    }
+  return mesh;
+}
@@ -0,0 +1,96 @@
+// Measures how fast each image decoder built in reads the images in a directory, and checks its pixels against
+// stb_image's. Throughput counts the bytes of the decoded pixels. Exits with 1 if a decoder fails on an image
+// stb_image reads, or if an exact one such as libspng differs from it at all.
+//
+// usage: decode_benchmark [directory] [runs]
+#include "image_decoder.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::high_resolution_clock;
+
+// best time of several runs, in seconds
+double measure(const ImageDecoder& decoder, std::span<const uint8_t> file, uint32_t runs, DecodedImage& image)
+{
+  double best = INFINITY;
+  for (uint32_t run = 0; run < runs; run++)
+  {
+    Clock::time_point start = Clock::now();
+    image = decoder.decode(file);
+    best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  return best;
+}
+
+// the largest channel difference, or -1 if the images differ in shape
+int32_t maxDifference(const DecodedImage& a, const DecodedImage& b)
+{
+  if (!a.pixels || !b.pixels || a.width != b.width || a.height != b.height || a.components != b.components)
+    return -1;
+  int32_t difference = 0;
+  for (size_t i = 0; i < size_t(a.width) * a.height * a.components; i++)
+    difference = std::max(difference, std::abs(a.pixels.get()[i] - b.pixels.get()[i]));
+  return difference;
+}
+}
+
+int main(int argc, char** argv)
+{
+  std::filesystem::path directory = argc > 1 ? argv[1] : "assets";
+  uint32_t runs = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 5;
+  std::vector<std::unique_ptr<ImageDecoder>> decoders = availableDecoders();
+  // stb_image always comes last
+  const ImageDecoder& reference = *decoders.back();
+
+  std::vector<std::filesystem::path> paths;
+  for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory))
+    if (entry.is_regular_file())
+      paths.push_back(entry.path());
+  std::sort(paths.begin(), paths.end());
+
+  bool mismatch = false;
+  std::cout << std::format("{} decoders, best of {} runs", decoders.size(), runs) << std::endl;
+  std::cout << std::format("{:<28} {:<14} {:>11} {:>10} {:>10} {:>8} {:>9}", "image", "decoder", "size", "ms", "MB/s",
+                           "speedup", "max diff")
+            << std::endl;
+  for (const std::filesystem::path& path : paths)
+  {
+    MappedFile file(path);
+    if (!file)
+      continue;
+    DecodedImage expected;
+    double referenceTime = measure(reference, file.data(), runs, expected);
+    // not an image
+    if (!expected.pixels)
+      continue;
+
+    std::string name = path.filename().string();
+    std::string size = std::format("{}x{}x{}", expected.width, expected.height, expected.components);
+    double megabytes = size_t(expected.width) * expected.height * expected.components / 1e6;
+    for (const std::unique_ptr<ImageDecoder>& decoder : decoders)
+    {
+      if (!decoder->accepts(file.data()))
+        continue;
+      DecodedImage image;
+      double time = decoder.get() == &reference ? referenceTime : measure(*decoder, file.data(), runs, image);
+      int32_t difference = decoder.get() == &reference ? 0 : maxDifference(expected, image);
+      mismatch |= difference < 0 || (difference > 0 && decoder->exact());
+      std::cout << std::format("{:<28} {:<14} {:>11} {:>10.2f} {:>10.1f} {:>7.2f}x {:>9}", name, decoder->name(),
+                               size, time * 1e3, megabytes / time, referenceTime / time,
+                               difference == 0 ? "exact" : difference < 0 ? "failed" : std::to_string(difference))
+                << std::endl;
+    }
+  }
+  return mismatch ? 1 : 0;
+}
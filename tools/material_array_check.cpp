@@ -0,0 +1,258 @@
+// Draws every material through lighting.glsl's SampleMaterial() on an offscreen EGL context and checks that each one
+// samples its own maps: on the texture array path, as --no-bindless forces, and on the bindless path where the driver
+// has GL_ARB_bindless_texture. Each map is a flat colour, and their sizes spread the materials over several arrays
+// while others share an array by layer. Needs a GL 4.3 driver, such as Mesa's llvmpipe, but no window.
+//
+// usage: material_array_check, from the source root
+#include "check.hpp"
+#include "material_library.hpp"
+#include "shader.hpp"
+#include "texture_cache.hpp"
+#include "texture_loader.hpp"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <glad/glad.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const Uniform<int32_t> materialIndex("materialIndex");
+const Uniform<int32_t> showSpecular("showSpecular");
+
+// a fullscreen triangle
+constexpr const char* vertexSource = R"(#version 430 core
+layout (location = 2) out vec2 TexCoords;
+void main()
+{
+  TexCoords = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  gl_Position = vec4(TexCoords * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// the material's diffuse or specular colour, unlit
+constexpr const char* fragmentSource = R"(#version 430 core
+#ifdef BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
+layout (location = 0) out vec4 FragColor;
+layout (location = 2) in vec2 TexCoords;
+layout (location = 30) uniform int showSpecular;
+)";
+// then lighting.glsl, included by absolute path since the file is written elsewhere, and
+constexpr const char* fragmentMain = R"(
+void main()
+{
+  MaterialSample material = SampleMaterial();
+  FragColor = vec4(showSpecular != 0 ? material.specular : material.diffuse, 1.0);
+}
+)";
+
+constexpr uint32_t targetSize = 4;
+
+struct FlatMap
+{
+  std::string path;
+  uint32_t size;
+  std::array<uint8_t, 3> rgb;
+};
+
+struct TestMaterial
+{
+  FlatMap diffuse;
+  // none when packed
+  std::optional<FlatMap> specular;
+};
+
+// the diffuse map's alpha, opaque in a PPM, when packed
+std::array<uint8_t, 3> specularColor(const TestMaterial& material)
+{
+  return material.specular ? material.specular->rgb : std::array<uint8_t, 3>{255, 255, 255};
+}
+
+bool createContext()
+{
+  auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  EGLDisplay display = getPlatformDisplay
+    ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+    : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API))
+    return false;
+  const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint configs = 0;
+  eglChooseConfig(display, configAttributes, &config, 1, &configs);
+  // shader storage buffers need 4.3, as in the application
+  const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 3,
+                                      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+  EGLContext context = eglCreateContext(display, configs ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+  return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)
+    && gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+}
+
+void writeFile(const std::filesystem::path& path, const std::string& contents)
+{
+  std::ofstream(path, std::ios::binary) << contents;
+}
+
+void writeMap(const FlatMap& map)
+{
+  std::string pixels;
+  for (uint32_t i = 0; i < map.size * map.size; i++)
+    pixels.append(map.rgb.begin(), map.rgb.end());
+  writeFile(map.path, std::format("P6 {} {} 255\n", map.size, map.size) + pixels);
+}
+
+// the colour one draw of the material leaves in the target
+std::array<uint8_t, 3> draw(Shader& shader, uint32_t material, bool specular)
+{
+  shader.set(materialIndex, int32_t(material));
+  shader.set(showSpecular, int32_t(specular));
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  uint8_t pixel[4];
+  glReadPixels(targetSize / 2, targetSize / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  return {pixel[0], pixel[1], pixel[2]};
+}
+
+bool matches(std::array<uint8_t, 3> drawn, std::array<uint8_t, 3> expected)
+{
+  // sRGB mips of a flat colour round back to within a level of it
+  for (uint32_t c = 0; c < 3; c++)
+    if (std::abs(int32_t(drawn[c]) - expected[c]) > 2)
+      return false;
+  return true;
+}
+
+void checkPath(bool allowBindless, const std::filesystem::path& directory, const std::vector<TestMaterial>& materials)
+{
+  TextureLoader loader;
+  TextureCache cache(loader);
+  MaterialLibrary library(cache, 64 << 20, allowBindless);
+  const char* path = library.bindless ? "bindless" : "texture arrays";
+  if (allowBindless && !library.bindless)
+  {
+    std::cout << "bindless: skipped, the driver has no GL_ARB_bindless_texture" << std::endl;
+    return;
+  }
+  for (const TestMaterial& material : materials)
+    if (material.specular)
+      library.add(material.diffuse.path, material.specular->path, 32.0f);
+    else
+      library.addPacked(material.diffuse.path, 32.0f);
+
+  ShaderDefines defines;
+  if (library.bindless)
+    defines.emplace_back("BINDLESS", "1");
+  Shader shader((directory / "check.vert").string(), (directory / "check.frag").string(), defines);
+  shader.wait();
+  check(shader.ready(), std::format("{}: the check program did not link", path));
+  if (!shader.ready())
+    return;
+  if (const ShaderReflection::Block* block = shader.reflect().findStorageBlock("MaterialBlock"))
+    for (const std::string& problem : library.validate(*block))
+      check(false, std::format("{}: {}", path, problem));
+
+  // the application's lighting program has to build for this path too
+  ShaderDefines lightingDefines = defines;
+  lightingDefines.emplace_back("POINT_LIGHT_COUNT", "4u");
+  Shader lighting("shaders/cube.vert", "shaders/cube.frag", lightingDefines);
+  lighting.wait();
+  check(lighting.ready(), std::format("{}: the lighting program did not link", path));
+  shader.use();
+
+  // maps show the placeholder until they have loaded and been packed, so draw frames until every material samples
+  // its own colours
+  std::vector<std::array<uint8_t, 3>> drawn(materials.size() * 2);
+  bool done = false;
+  for (Clock::time_point start = Clock::now(); !done && Clock::now() - start < std::chrono::seconds(10);)
+  {
+    cache.poll();
+    library.update();
+    library.bind();
+    done = true;
+    for (uint32_t i = 0; i < materials.size(); i++)
+    {
+      drawn[i * 2] = draw(shader, i, false);
+      drawn[i * 2 + 1] = draw(shader, i, true);
+      done &= matches(drawn[i * 2], materials[i].diffuse.rgb) && matches(drawn[i * 2 + 1], specularColor(materials[i]));
+    }
+  }
+
+  for (uint32_t i = 0; i < materials.size(); i++)
+  {
+    const TestMaterial& material = materials[i];
+    std::array<uint8_t, 3> specular = specularColor(material);
+    check(matches(drawn[i * 2], material.diffuse.rgb),
+          std::format("{}: material {} draws diffuse {} {} {}, not {} {} {}", path, i, drawn[i * 2][0], drawn[i * 2][1],
+                      drawn[i * 2][2], material.diffuse.rgb[0], material.diffuse.rgb[1], material.diffuse.rgb[2]));
+    check(matches(drawn[i * 2 + 1], specular),
+          std::format("{}: material {} draws specular {} {} {}, not {} {} {}", path, i, drawn[i * 2 + 1][0],
+                      drawn[i * 2 + 1][1], drawn[i * 2 + 1][2], specular[0], specular[1], specular[2]));
+  }
+  std::cout << std::format("{}: {} materials in {} arrays", path, materials.size(), library.arrays.size())
+            << std::endl;
+}
+}
+
+int main()
+{
+  if (!createContext())
+  {
+    std::cout << "Cannot create an offscreen OpenGL 4.3 context" << std::endl;
+    return 1;
+  }
+  std::cout << std::format("OpenGL renderer: {}", (const char*)glGetString(GL_RENDERER)) << std::endl;
+
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / "material_array_check";
+  std::filesystem::create_directories(directory);
+  writeFile(directory / "check.vert", vertexSource);
+  std::string lighting = std::filesystem::absolute("shaders/lighting.glsl").generic_string();
+  writeFile(directory / "check.frag", fragmentSource + std::format("#include \"{}\"", lighting) + fragmentMain);
+
+  // diffuse maps of one size share an array, and specular maps of another size share a second; the rest each
+  // need their own
+  auto map = [&](const char* name, uint32_t size, std::array<uint8_t, 3> rgb)
+  { return FlatMap{(directory / name).string(), size, rgb}; };
+  std::vector<TestMaterial> materials = {
+    {map("red.ppm", 16, {200, 40, 40}), map("white.ppm", 32, {230, 230, 230})},
+    {map("green.ppm", 64, {30, 180, 60}), map("grey.ppm", 8, {90, 90, 90})},
+    {map("blue.ppm", 16, {40, 60, 210}), map("dark.ppm", 32, {20, 20, 20})},
+    {map("yellow.ppm", 128, {220, 200, 30}), std::nullopt},
+  };
+  for (const TestMaterial& material : materials)
+  {
+    writeMap(material.diffuse);
+    if (material.specular)
+      writeMap(*material.specular);
+  }
+
+  uint32_t color, framebuffer, vertexArray;
+  glGenTextures(1, &color);
+  glBindTexture(GL_TEXTURE_2D, color);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, targetSize, targetSize);
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+  glViewport(0, 0, targetSize, targetSize);
+  glGenVertexArrays(1, &vertexArray);
+  glBindVertexArray(vertexArray);
+
+  checkPath(false, directory, materials);
+  checkPath(true, directory, materials);
+  check(glGetError() == GL_NO_ERROR, "a GL call failed");
+
+  glDeleteVertexArrays(1, &vertexArray);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteTextures(1, &color);
+  std::filesystem::remove_all(directory);
+  return checksPassed("Material array");
+}
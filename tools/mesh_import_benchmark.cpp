@@ -0,0 +1,142 @@
+// Measures how fast importMesh() parses a model on different thread counts, what optimizeMesh() does to its vertex
+// cache behaviour, and how long a mesh cache hit takes to map. Without a model it writes a sphere of about a million
+// triangles as OBJ to the temporary directory. Throughput counts the bytes of the source file.
+//
+// usage: mesh_import_benchmark [model] [runs]
+#include "mesh_importer.hpp"
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::high_resolution_clock;
+
+// a UV sphere with smooth normals, as 2 * segments^2 triangles
+void writeSphere(const std::filesystem::path& path, uint32_t segments)
+{
+  std::string text;
+  for (uint32_t y = 0; y <= segments; y++)
+    for (uint32_t x = 0; x <= segments; x++)
+    {
+      float u = float(x) / segments;
+      float v = float(y) / segments;
+      float theta = u * 2.0f * std::numbers::pi_v<float>;
+      float phi = v * std::numbers::pi_v<float>;
+      float px = std::sin(phi) * std::cos(theta);
+      float py = std::cos(phi);
+      float pz = std::sin(phi) * std::sin(theta);
+      text += std::format("v {:.6f} {:.6f} {:.6f}\nvt {:.6f} {:.6f}\nvn {:.6f} {:.6f} {:.6f}\n", px, py, pz, u, v, px,
+                          py, pz);
+    }
+  for (uint32_t y = 0; y < segments; y++)
+    for (uint32_t x = 0; x < segments; x++)
+    {
+      uint32_t a = y * (segments + 1) + x + 1;
+      uint32_t b = a + 1;
+      uint32_t c = a + segments + 1;
+      uint32_t d = c + 1;
+      text += std::format("f {0}/{0}/{0} {1}/{1}/{1} {2}/{2}/{2} {3}/{3}/{3}\n", a, b, d, c);
+    }
+  std::ofstream(path, std::ios::binary).write(text.data(), text.size());
+}
+}
+
+int main(int argc, char** argv)
+{
+  std::filesystem::path path = argc > 1 ? argv[1] : std::filesystem::temp_directory_path() / "sphere_1m.obj";
+  uint32_t runs = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 3;
+  if (argc <= 1 && !std::filesystem::exists(path))
+    writeSphere(path, 708);
+  size_t bytes = std::filesystem::file_size(path);
+
+  std::vector<uint32_t> threadCounts = {1};
+  uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  for (uint32_t threads = 2; threads < cores; threads *= 2)
+    threadCounts.push_back(threads);
+  if (cores > 1)
+    threadCounts.push_back(cores);
+
+  std::vector<double> times;
+  MeshData mesh;
+  for (uint32_t threads : threadCounts)
+  {
+    double best = INFINITY;
+    for (uint32_t run = 0; run < runs; run++)
+    {
+      Clock::time_point start = Clock::now();
+      std::optional<MeshData> imported = importMesh(path, threads);
+      best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+      if (!imported)
+        return 1;
+      mesh = std::move(*imported);
+    }
+    times.push_back(best);
+  }
+
+  std::cout << std::format("{}: {:.1f} MB, {} triangles, {} vertices, best of {} runs", path.string(), bytes / 1e6,
+                           mesh.indices.size() / 3, mesh.vertices.size(), runs)
+            << std::endl;
+  std::cout << std::format("{:>8} {:>10} {:>10} {:>8}", "threads", "ms", "MB/s", "speedup") << std::endl;
+  for (size_t i = 0; i < threadCounts.size(); i++)
+    std::cout << std::format("{:>8} {:>10.1f} {:>10.1f} {:>7.2f}x", threadCounts[i], times[i] * 1e3,
+                             bytes / 1e6 / times[i], times[0] / times[i])
+              << std::endl;
+
+  // the statistics are simulated for small and large caches, as GPUs differ
+  constexpr uint32_t cacheSizes[] = {16, 32};
+  VertexCacheStats before[2];
+  for (uint32_t i = 0; i < 2; i++)
+    before[i] = analyzeVertexCache(mesh.indices, mesh.vertices.size(), cacheSizes[i]);
+  Clock::time_point optimizeStart = Clock::now();
+  optimizeMesh(mesh);
+  double optimizeTime = std::chrono::duration<double>(Clock::now() - optimizeStart).count();
+  std::cout << std::format("optimizeMesh: {:.1f} ms", optimizeTime * 1e3) << std::endl;
+  std::cout << std::format("{:>8} {:>16} {:>16}", "cache", "ACMR", "ATVR") << std::endl;
+  for (uint32_t i = 0; i < 2; i++)
+  {
+    VertexCacheStats after = analyzeVertexCache(mesh.indices, mesh.vertices.size(), cacheSizes[i]);
+    std::cout << std::format("{:>8} {:>7.3f} -> {:.3f} {:>7.3f} -> {:.3f}", cacheSizes[i], before[i].acmr, after.acmr,
+                             before[i].atvr, after.atvr)
+              << std::endl;
+  }
+
+  // a hit maps the file and checks its header; the buffer upload then reads the mapping straight into the driver,
+  // which summing its bytes stands in for here
+  EncodedMesh encoded = encodeMesh(mesh, compactVertexFormat);
+  uint64_t key = MeshCache::key(path, compactVertexFormat);
+  MeshCache::store(key, encoded);
+  double mapTime = INFINITY;
+  double readTime = INFINITY;
+  uint64_t sum = 0;
+  for (uint32_t run = 0; run < runs; run++)
+  {
+    Clock::time_point start = Clock::now();
+    std::optional<CachedMesh> cached = MeshCache::load(key);
+    Clock::time_point mapped = Clock::now();
+    if (!cached)
+      return 1;
+    for (std::span<const uint8_t> data : {cached->vertices, cached->indices})
+      for (uint8_t byte : data)
+        sum += byte;
+    mapTime = std::min(mapTime, std::chrono::duration<double>(mapped - start).count());
+    readTime = std::min(readTime, std::chrono::duration<double>(Clock::now() - mapped).count());
+  }
+  size_t cachedBytes = encoded.vertices.size() + encoded.indices.size();
+  std::cout << std::format("cache hit: {:.1f} MB in {:.3f} ms to map, {:.1f} ms to read through ({:.0f}x faster "
+                           "than the fastest import, checksum {})",
+                           cachedBytes / 1e6, mapTime * 1e3, readTime * 1e3,
+                           *std::min_element(times.begin(), times.end()) / (mapTime + readTime), sum % 1000)
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,91 @@
+// Checks optimizeMesh() on the CPU. A sphere is optimized in its generated order and with its triangles shuffled; the
+// result has to draw the same triangles with the same winding, and must not miss the simulated vertex cache more
+// often than the input did.
+//
+// usage: mesh_optimizer_check
+#include "check.hpp"
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+// the triangles by the bytes of their vertices, as optimizeVertexFetch() renumbers them. Each starts at its smallest
+// vertex, which keeps the winding, and the list is sorted, so two meshes drawing the same triangles compare equal.
+using Triangle = std::array<std::array<uint8_t, sizeof(Vertex)>, 3>;
+
+std::vector<Triangle> triangles(const MeshData& mesh)
+{
+  std::vector<Triangle> result;
+  for (size_t i = 0; i + 3 <= mesh.indices.size(); i += 3)
+  {
+    Triangle triangle;
+    for (uint32_t corner = 0; corner < 3; corner++)
+      std::memcpy(triangle[corner].data(), &mesh.vertices[mesh.indices[i + corner]], sizeof(Vertex));
+    std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+    result.push_back(triangle);
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+void checkOptimization(const char* name, MeshData mesh)
+{
+  std::vector<Triangle> before = triangles(mesh);
+  VertexCacheStats large = analyzeVertexCache(mesh.indices, mesh.vertices.size(), 32);
+  MeshOptimization optimization = optimizeMesh(mesh);
+  VertexCacheStats optimizedLarge = analyzeVertexCache(mesh.indices, mesh.vertices.size(), 32);
+
+  check(triangles(mesh) == before, std::format("{}: the optimized mesh draws different triangles", name));
+  check(optimization.after.acmr <= optimization.before.acmr,
+        std::format("{}: ACMR rose from {:.3f} to {:.3f}", name, optimization.before.acmr, optimization.after.acmr));
+  check(optimizedLarge.acmr <= large.acmr,
+        std::format("{}: ACMR with 32 vertices cached rose from {:.3f} to {:.3f}", name, large.acmr,
+                    optimizedLarge.acmr));
+  std::cout << std::format("{}: {} triangles, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}", name,
+                           mesh.indices.size() / 3, optimization.before.acmr, optimization.after.acmr,
+                           optimization.before.atvr, optimization.after.atvr)
+            << std::endl;
+}
+
+void checkRestarts(MeshData mesh)
+{
+  size_t triangleCount = mesh.indices.size() / 3;
+  std::vector<size_t> restarts = optimizeVertexCache(mesh.indices, mesh.vertices.size());
+  check(!restarts.empty() && restarts[0] == 0, "restarts: the first triangle is not a restart");
+  check(std::adjacent_find(restarts.begin(), restarts.end(), std::greater_equal<size_t>()) == restarts.end()
+          && (restarts.empty() || restarts.back() < triangleCount),
+        "restarts: not increasing triangle indices within the mesh");
+  std::cout << std::format("restarts: {} in {} triangles", restarts.size(), triangleCount) << std::endl;
+}
+}
+
+int main()
+{
+  MeshData generated = sphere(glm::vec3(0.0f), 1.0f, 64);
+  // shuffled triangles, each also starting from a random corner, which must survive as the same winding
+  MeshData shuffled = generated;
+  std::mt19937 random(1);
+  std::vector<uint32_t> order(shuffled.indices.size() / 3);
+  for (uint32_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::shuffle(order.begin(), order.end(), random);
+  for (uint32_t i = 0; i < order.size(); i++)
+  {
+    uint32_t* triangle = &shuffled.indices[i * 3];
+    std::copy_n(&generated.indices[order[i] * 3], 3, triangle);
+    std::rotate(triangle, triangle + random() % 3, triangle + 3);
+  }
+
+  checkOptimization("sphere", generated);
+  checkOptimization("shuffled sphere", shuffled);
+  checkRestarts(shuffled);
+  return checksPassed("Mesh optimizer");
+}
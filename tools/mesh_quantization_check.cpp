@@ -0,0 +1,124 @@
+// Checks that compactVertexFormat loses no more than its encodings allow, without a GPU. A sphere away from the
+// origin and a grid spanning the unit texture coordinate range are encoded, decoded again from the vertex bytes, and
+// compared with the originals: positions within half a 16-bit step of the mesh's scale, normals within half a 10-bit
+// step, and texture coordinates within half a half-float ulp. The error encodeMesh() reports is held to the same
+// bounds.
+//
+// usage: mesh_quantization_check
+#include "check.hpp"
+#include "mesh.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <glm/gtc/packing.hpp>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace
+{
+// a flat grid of cells x cells squares whose texture coordinates step evenly from 0 to 1
+MeshData grid(uint32_t cells)
+{
+  MeshData mesh;
+  for (uint32_t y = 0; y <= cells; y++)
+    for (uint32_t x = 0; x <= cells; x++)
+    {
+      glm::vec2 uv(float(x) / cells, float(y) / cells);
+      mesh.vertices.push_back({glm::vec3(uv.x - 0.5f, 0.0f, uv.y - 0.5f), glm::vec3(0.0f, 1.0f, 0.0f), uv});
+    }
+  for (uint32_t y = 0; y < cells; y++)
+    for (uint32_t x = 0; x < cells; x++)
+    {
+      uint32_t a = y * (cells + 1) + x;
+      uint32_t c = a + cells + 1;
+      mesh.indices.insert(mesh.indices.end(), {a, c, c + 1, a, c + 1, a + 1});
+    }
+  return mesh;
+}
+
+// half the gap between a half float and the next one up, at this magnitude
+float halfUlp(float value)
+{
+  // half floats have 10 fraction bits, and below 2^-14 they are denormal with a fixed step
+  int32_t exponent = std::max(std::ilogb(std::max(std::abs(value), 1e-30f)), -14);
+  return std::ldexp(0.5f, exponent - 10);
+}
+
+void checkMesh(const char* name, const MeshData& mesh)
+{
+  EncodedMesh encoded = encodeMesh(mesh, compactVertexFormat);
+  const MeshLayout& layout = encoded.layout;
+  check(layout.vertexCount == mesh.vertices.size() && encoded.vertices.size() == mesh.vertices.size() * 16,
+        std::format("{}: {} vertices in {} bytes", name, layout.vertexCount, encoded.vertices.size()));
+
+  glm::vec3 low = mesh.vertices[0].position;
+  glm::vec3 high = low;
+  for (const Vertex& vertex : mesh.vertices)
+  {
+    low = glm::min(low, vertex.position);
+    high = glm::max(high, vertex.position);
+  }
+  glm::vec3 extent = (high - low) * 0.5f;
+  float scale = std::max({extent.x, extent.y, extent.z});
+  float magnitude = std::max({std::abs(low.x), std::abs(low.y), std::abs(low.z), std::abs(high.x), std::abs(high.y),
+                              std::abs(high.z)});
+  // half a 16-bit step, plus the float rounding of applying the dequantization to it
+  float positionBound = 0.5f * scale / 32767.0f + 4.0f * magnitude * std::numeric_limits<float>::epsilon();
+  float normalBound = 0.5f / 511.0f + 4.0f * std::numeric_limits<float>::epsilon();
+  float texCoordBound = halfUlp(1.0f - std::numeric_limits<float>::epsilon());
+
+  // decoded from the buffer the way the vertex fetch reads it
+  float positionError = 0.0f;
+  float normalError = 0.0f;
+  uint32_t texCoordFailures = 0;
+  for (size_t i = 0; i < mesh.vertices.size(); i++)
+  {
+    const Vertex& vertex = mesh.vertices[i];
+    const uint8_t* bytes = encoded.vertices.data() + i * 16;
+    uint64_t position;
+    uint32_t normal, texCoords;
+    std::memcpy(&position, bytes, sizeof(position));
+    std::memcpy(&normal, bytes + 8, sizeof(normal));
+    std::memcpy(&texCoords, bytes + 12, sizeof(texCoords));
+
+    glm::vec3 decoded = glm::vec3(layout.dequantize * glm::vec4(glm::vec3(glm::unpackSnorm4x16(position)), 1.0f));
+    glm::vec3 difference = glm::abs(decoded - vertex.position);
+    positionError = std::max({positionError, difference.x, difference.y, difference.z});
+    difference = glm::abs(glm::vec3(glm::unpackSnorm3x10_1x2(normal)) - vertex.normal);
+    normalError = std::max({normalError, difference.x, difference.y, difference.z});
+    glm::vec2 uv = glm::unpackHalf2x16(texCoords);
+    for (uint32_t axis = 0; axis < 2; axis++)
+      if (std::abs(uv[axis] - vertex.texCoords[axis]) > halfUlp(vertex.texCoords[axis]))
+        texCoordFailures++;
+  }
+
+  check(positionError <= positionBound,
+        std::format("{}: positions are off by {:.3g}, allowed {:.3g}", name, positionError, positionBound));
+  check(normalError <= normalBound,
+        std::format("{}: normals are off by {:.3g}, allowed {:.3g}", name, normalError, normalBound));
+  check(texCoordFailures == 0,
+        std::format("{}: {} texture coordinates are off by more than half a half-float ulp", name, texCoordFailures));
+
+  check(layout.error.position <= positionBound,
+        std::format("{}: reported position error {:.3g}, allowed {:.3g}", name, layout.error.position, positionBound));
+  check(layout.error.normal <= normalBound,
+        std::format("{}: reported normal error {:.3g}, allowed {:.3g}", name, layout.error.normal, normalBound));
+  check(layout.error.texCoords <= texCoordBound,
+        std::format("{}: reported texture coordinate error {:.3g}, allowed {:.3g}", name, layout.error.texCoords,
+                    texCoordBound));
+
+  std::cout << std::format("{}: {} vertices, position error {:.3g} (scale {:.3g}), normal error {:.3g}, texture "
+                           "coordinate error {:.3g}",
+                           name, mesh.vertices.size(), positionError, scale, normalError, layout.error.texCoords)
+            << std::endl;
+}
+}
+
+int main()
+{
+  checkMesh("sphere", sphere(glm::vec3(10.0f, -4.0f, 2.5f), 3.0f, 96));
+  // not a power of two, so most coordinates round
+  checkMesh("grid", grid(1000));
+  return checksPassed("Quantization");
+}
@@ -0,0 +1,120 @@
+// Measures mip chain generation throughput for each filter, comparing the scalar reference kernels with the SIMD
+// ones on one thread and on every core. Throughput counts the bytes of the full resolution image.
+//
+// usage: mipmap_benchmark [image] [runs]
+#include "mipmap.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace
+{
+using Clock = std::chrono::high_resolution_clock;
+
+struct Image
+{
+  std::vector<uint8_t> pixels;
+  uint32_t width;
+  uint32_t height;
+  uint32_t components;
+};
+
+// a gradient with noise, so neither kernel path can skip work on flat regions
+Image syntheticImage(uint32_t size)
+{
+  Image image = {std::vector<uint8_t>(size_t(size) * size * 4), size, size, 4};
+  uint32_t seed = 1;
+  for (uint32_t y = 0; y < size; y++)
+    for (uint32_t x = 0; x < size; x++)
+    {
+      seed = seed * 1664525u + 1013904223u;
+      uint8_t* pixel = image.pixels.data() + (size_t(y) * size + x) * 4;
+      pixel[0] = x * 255 / size;
+      pixel[1] = y * 255 / size;
+      pixel[2] = seed >> 24;
+      pixel[3] = 255;
+    }
+  return image;
+}
+
+// best time of several runs, in seconds
+double measure(const Image& image, const MipmapOptions& options, uint32_t runs, std::vector<MipLevel>& levels)
+{
+  double best = INFINITY;
+  for (uint32_t run = 0; run < runs; run++)
+  {
+    Clock::time_point start = Clock::now();
+    levels = generateMipmaps(image.pixels.data(), image.width, image.height, image.components, options);
+    best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  return best;
+}
+
+int32_t maxDifference(const std::vector<MipLevel>& a, const std::vector<MipLevel>& b)
+{
+  int32_t difference = 0;
+  for (size_t level = 0; level < a.size(); level++)
+    for (size_t i = 0; i < a[level].pixels.size(); i++)
+      difference = std::max(difference, std::abs(a[level].pixels[i] - b[level].pixels[i]));
+  return difference;
+}
+}
+
+int main(int argc, char** argv)
+{
+  Image image;
+  if (argc > 1)
+  {
+    int width, height, components;
+    uint8_t* pixels = stbi_load(argv[1], &width, &height, &components, 0);
+    if (!pixels)
+    {
+      std::cerr << std::format("Cannot load {}: {}", argv[1], stbi_failure_reason()) << std::endl;
+      return 1;
+    }
+    image = {std::vector<uint8_t>(pixels, pixels + size_t(width) * height * components), uint32_t(width),
+             uint32_t(height), uint32_t(components)};
+    stbi_image_free(pixels);
+  }
+  else
+    image = syntheticImage(2048);
+  uint32_t runs = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 5;
+  uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+  double megabytes = image.pixels.size() / 1e6;
+
+  std::cout << std::format("{}x{} with {} components, best of {} runs, {} kernels on up to {} threads",
+                           image.width, image.height, image.components, runs, mipmapInstructionSet(), threads)
+            << std::endl;
+  std::cout << std::format("{:<8} {:<7} {:>12} {:>12} {:>8} {:>12} {:>8} {:>9}", "filter", "space", "scalar MB/s",
+                           "SIMD MB/s", "speedup", "threads MB/s", "speedup", "max diff")
+            << std::endl;
+
+  const std::pair<MipFilter, const char*> filters[] = {
+    {MipFilter::Box, "box"},
+    {MipFilter::Kaiser, "kaiser"},
+    {MipFilter::Lanczos, "lanczos"},
+  };
+  for (auto [filter, name] : filters)
+    for (bool srgb : {false, true})
+    {
+      std::vector<MipLevel> reference, vector, threaded;
+      double scalarTime = measure(image, {filter, srgb, 1, false}, runs, reference);
+      double simdTime = measure(image, {filter, srgb, 1, true}, runs, vector);
+      double threadedTime = measure(image, {filter, srgb, threads, true}, runs, threaded);
+      std::cout << std::format("{:<8} {:<7} {:>12.1f} {:>12.1f} {:>7.2f}x {:>12.1f} {:>7.2f}x {:>9}", name,
+                               srgb ? "sRGB" : "linear", megabytes / scalarTime, megabytes / simdTime,
+                               scalarTime / simdTime, megabytes / threadedTime, scalarTime / threadedTime,
+                               std::max(maxDifference(reference, vector), maxDifference(reference, threaded)))
+                << std::endl;
+    }
+  return 0;
+}
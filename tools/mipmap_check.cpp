@@ -0,0 +1,81 @@
+// Checks the SIMD mip kernels against the scalar reference ones on every instruction set this machine runs. Widths
+// from 1 to 33 pixels with 1 to 4 components leave every remainder a vector loop can end on, for each filter in
+// linear and sRGB space. The levels have to come out byte for byte the same, except that AVX2's fused multiply-add
+// rounds the filtered sums once rather than twice, which can move a value across a rounding boundary.
+//
+// usage: mipmap_check
+#include "check.hpp"
+#include "mipmap.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// noise, so an edge that reads the wrong pixels cannot average out to the right value
+std::vector<uint8_t> noise(uint32_t width, uint32_t height, uint32_t components)
+{
+  std::vector<uint8_t> pixels(size_t(width) * height * components);
+  uint32_t seed = width * 131 + height * 7 + components;
+  for (uint8_t& value : pixels)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    value = seed >> 24;
+  }
+  return pixels;
+}
+
+int32_t maxDifference(const std::vector<MipLevel>& a, const std::vector<MipLevel>& b)
+{
+  int32_t difference = a.size() == b.size() ? 0 : 255;
+  for (size_t level = 0; level < std::min(a.size(), b.size()); level++)
+    for (size_t i = 0; i < std::min(a[level].pixels.size(), b[level].pixels.size()); i++)
+      difference = std::max(difference, std::abs(a[level].pixels[i] - b[level].pixels[i]));
+  return difference;
+}
+}
+
+int main()
+{
+  const std::pair<MipFilter, const char*> filters[] = {
+    {MipFilter::Box, "box"},
+    {MipFilter::Kaiser, "kaiser"},
+    {MipFilter::Lanczos, "lanczos"},
+  };
+  // without AVX2 both settings run the same kernels, which are checked once
+  std::vector<bool> avx2Settings = {true};
+  if (std::string_view(mipmapInstructionSet({.avx2 = true})) != mipmapInstructionSet({.avx2 = false}))
+    avx2Settings.push_back(false);
+
+  for (bool avx2 : avx2Settings)
+  {
+    const char* instructionSet = mipmapInstructionSet({.avx2 = avx2});
+    bool fused = std::string_view(instructionSet) == "AVX2";
+    uint32_t images = 0;
+    for (uint32_t components = 1; components <= 4; components++)
+      for (uint32_t width = 1; width <= 33; width++)
+        for (uint32_t height : {1u, 7u, 8u})
+        {
+          std::vector<uint8_t> pixels = noise(width, height, components);
+          for (auto [filter, name] : filters)
+            for (bool srgb : {false, true})
+            {
+              MipmapOptions options = {.filter = filter, .srgb = srgb, .simd = false, .avx2 = avx2};
+              std::vector<MipLevel> reference = generateMipmaps(pixels.data(), width, height, components, options);
+              options.simd = true;
+              std::vector<MipLevel> vector = generateMipmaps(pixels.data(), width, height, components, options);
+              int32_t tolerance = fused && filter != MipFilter::Box ? 1 : 0;
+              int32_t difference = maxDifference(reference, vector);
+              check(difference <= tolerance, std::format("{} {} {}: {}x{} with {} components differs from scalar by {}",
+                                                 instructionSet, name, srgb ? "sRGB" : "linear", width, height,
+                                                 components, difference));
+            }
+          images++;
+        }
+    std::cout << std::format("{}: {} images", instructionSet, images) << std::endl;
+  }
+  return checksPassed("Mipmap");
+}
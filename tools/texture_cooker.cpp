@@ -0,0 +1,167 @@
+// Converts an image to a block-compressed KTX2 texture with a precomputed mip chain, so the application can upload
+// it without decoding anything at startup. With --alpha, a second image's intensity replaces the alpha channel, which
+// packs e.g. a specular map into its diffuse map so shaders fetch both at once.
+//
+// usage: texture_cooker <input> <output.ktx2> <bc1|bc3|bc5> [--srgb] [--filter box|kaiser|lanczos] [--alpha <image>]
+#include "block_compression.hpp"
+#include "ktx2.hpp"
+#include "mipmap.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace
+{
+// peak signal to noise ratio over the channels the format stores
+double psnr(BlockFormat format, const std::vector<uint8_t>& original, const std::vector<uint8_t>& decoded)
+{
+  bool channels[4] = {true, true, format != BlockFormat::BC5, format == BlockFormat::BC3};
+  double squaredError = 0.0;
+  size_t samples = 0;
+  for (size_t i = 0; i < original.size(); i++)
+    if (channels[i % 4])
+    {
+      double difference = double(original[i]) - decoded[i];
+      squaredError += difference * difference;
+      samples++;
+    }
+  if (squaredError == 0.0)
+    return INFINITY;
+  return 10.0 * std::log10(255.0 * 255.0 / (squaredError / samples));
+}
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 4)
+  {
+    std::cerr << "usage: texture_cooker <input> <output.ktx2> <bc1|bc3|bc5> [--srgb] [--filter box|kaiser|lanczos] "
+                 "[--alpha <image>]"
+              << std::endl;
+    return 1;
+  }
+  const char* input = argv[1];
+  const char* output = argv[2];
+  std::string_view formatName = argv[3];
+  // offline there is time for the sharper filter
+  MipmapOptions mipmaps = {.filter = MipFilter::Kaiser, .threads = std::max(std::thread::hardware_concurrency(), 1u)};
+  const char* alphaInput = nullptr;
+  for (int i = 4; i < argc; i++)
+  {
+    std::string_view option = argv[i];
+    std::string_view filter = i + 1 < argc ? argv[i + 1] : "";
+    if (option == "--srgb")
+      mipmaps.srgb = true;
+    else if (option == "--filter" && (filter == "box" || filter == "kaiser" || filter == "lanczos"))
+    {
+      mipmaps.filter = filter == "box" ? MipFilter::Box : filter == "kaiser" ? MipFilter::Kaiser : MipFilter::Lanczos;
+      i++;
+    }
+    else if (option == "--alpha" && i + 1 < argc)
+      alphaInput = argv[++i];
+    else
+    {
+      std::cerr << std::format("Unknown option {}", option) << std::endl;
+      return 1;
+    }
+  }
+  bool srgb = mipmaps.srgb;
+
+  BlockFormat format;
+  Ktx2Format fileFormat;
+  if (formatName == "bc1")
+  {
+    format = BlockFormat::BC1;
+    fileFormat = srgb ? Ktx2Format::BC1_RGB_SRGB : Ktx2Format::BC1_RGB_UNORM;
+  }
+  else if (formatName == "bc3")
+  {
+    format = BlockFormat::BC3;
+    fileFormat = srgb ? Ktx2Format::BC3_SRGB : Ktx2Format::BC3_UNORM;
+  }
+  else if (formatName == "bc5" && !srgb)
+  {
+    format = BlockFormat::BC5;
+    fileFormat = Ktx2Format::BC5_UNORM;
+  }
+  else
+  {
+    std::cerr << std::format("Unsupported format {}{}", formatName, srgb ? " with --srgb" : "") << std::endl;
+    return 1;
+  }
+  if (alphaInput && format != BlockFormat::BC3)
+  {
+    std::cerr << std::format("Format {} has no alpha channel to pack {} into", formatName, alphaInput) << std::endl;
+    return 1;
+  }
+
+  int width, height, components;
+  uint8_t* pixels = stbi_load(input, &width, &height, &components, 4);
+  if (!pixels)
+  {
+    std::cerr << std::format("Cannot load {}: {}", input, stbi_failure_reason()) << std::endl;
+    return 1;
+  }
+  std::vector<uint8_t> image(pixels, pixels + size_t(width) * height * 4);
+  stbi_image_free(pixels);
+
+  if (alphaInput)
+  {
+    // stb_image reduces the image to its luminance
+    int alphaWidth, alphaHeight, alphaComponents;
+    uint8_t* alpha = stbi_load(alphaInput, &alphaWidth, &alphaHeight, &alphaComponents, 1);
+    if (!alpha)
+    {
+      std::cerr << std::format("Cannot load {}: {}", alphaInput, stbi_failure_reason()) << std::endl;
+      return 1;
+    }
+    if (alphaWidth != width || alphaHeight != height)
+    {
+      std::cerr << std::format("{} is {}x{}, but {} is {}x{}", alphaInput, alphaWidth, alphaHeight, input, width,
+                               height)
+                << std::endl;
+      stbi_image_free(alpha);
+      return 1;
+    }
+    for (size_t i = 0; i < size_t(width) * height; i++)
+      image[i * 4 + 3] = alpha[i];
+    stbi_image_free(alpha);
+  }
+
+  using Clock = std::chrono::high_resolution_clock;
+  Clock::time_point start = Clock::now();
+
+  std::vector<std::vector<uint8_t>> levels = {compressImage(format, image.data(), width, height)};
+  double quality = psnr(format, image, decompressImage(format, levels[0].data(), width, height));
+  size_t uncompressedBytes = image.size();
+  for (const MipLevel& mip : generateMipmaps(image.data(), width, height, 4, mipmaps))
+  {
+    levels.push_back(compressImage(format, mip.pixels.data(), mip.width, mip.height));
+    uncompressedBytes += mip.pixels.size();
+  }
+
+  if (!writeKtx2(output, fileFormat, width, height, levels))
+  {
+    std::cerr << std::format("Cannot write {}", output) << std::endl;
+    return 1;
+  }
+
+  size_t compressedBytes = 0;
+  for (const std::vector<uint8_t>& level : levels)
+    compressedBytes += level.size();
+  std::chrono::duration<double, std::milli> time = Clock::now() - start;
+  std::cout << std::format("{} -> {}: {}x{} {}, {} levels, {:.1f} KiB -> {:.1f} KiB ({:.1f}x), level 0 PSNR {:.2f} dB, "
+                           "{:.1f} ms",
+                           input, output, width, height, formatName, levels.size(), uncompressedBytes / 1024.0,
+                           compressedBytes / 1024.0, double(uncompressedBytes) / compressedBytes, quality, time.count())
+            << std::endl;
+  return 0;
+}
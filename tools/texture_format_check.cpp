@@ -0,0 +1,155 @@
+// Checks the block compressor and the KTX2 writer and parser without a GPU. Known blocks have to decode back within
+// the error their format allows, and a written file has to parse back to the same levels while every truncated copy
+// of it is rejected.
+//
+// usage: texture_format_check
+#include "block_compression.hpp"
+#include "check.hpp"
+#include "ktx2.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+// the value a channel decodes to after quantizing it to bits, as the hardware replicates the high bits
+uint8_t representable(uint8_t value, uint32_t bits)
+{
+  uint32_t max = (1 << bits) - 1;
+  uint32_t quantized = (value * max + 127) / 255;
+  return quantized << (8 - bits) | quantized >> (2 * bits - 8);
+}
+
+// a colour BC1 endpoints store exactly
+void representable565(uint8_t* rgba, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+  rgba[0] = representable(r, 5);
+  rgba[1] = representable(g, 6);
+  rgba[2] = representable(b, 5);
+  rgba[3] = a;
+}
+
+// encodes and decodes one block, and checks each channel the format stores is within tolerance of the original
+void roundTrip(const char* name, BlockFormat format, const uint8_t* rgba, const int32_t tolerance[4])
+{
+  uint8_t block[16];
+  uint8_t decoded[64];
+  encodeBlock(format, rgba, block);
+  decodeBlock(format, block, decoded);
+  int32_t worst[4] = {};
+  for (uint32_t i = 0; i < 64; i++)
+    worst[i % 4] = std::max(worst[i % 4], std::abs(int32_t(rgba[i]) - decoded[i]));
+  for (uint32_t channel = 0; channel < 4; channel++)
+    check(tolerance[channel] < 0 || worst[channel] <= tolerance[channel],
+          std::format("{}: channel {} is off by {}, allowed {}", name, channel, worst[channel], tolerance[channel]));
+}
+
+void checkBlocks()
+{
+  // -1 skips a channel the format does not store
+  constexpr int32_t exactColor[4] = {0, 0, 0, -1};
+  constexpr int32_t exactAll[4] = {0, 0, 0, 0};
+  uint8_t rgba[64];
+
+  for (uint32_t i = 0; i < 16; i++)
+    representable565(&rgba[i * 4], 200, 100, 50, 255);
+  roundTrip("BC1 flat", BlockFormat::BC1, rgba, exactColor);
+  roundTrip("BC3 flat", BlockFormat::BC3, rgba, exactAll);
+
+  // left half one endpoint, right half the other
+  for (uint32_t i = 0; i < 16; i++)
+    if (i % 4 < 2)
+      representable565(&rgba[i * 4], 250, 20, 90, 255);
+    else
+      representable565(&rgba[i * 4], 10, 230, 160, 255);
+  roundTrip("BC1 two colours", BlockFormat::BC1, rgba, exactColor);
+  roundTrip("BC3 two colours", BlockFormat::BC3, rgba, exactAll);
+
+  // alpha from 0 to 255 in steps of 17; the 8 level palette between the extremes is 255 / 7 apart
+  for (uint32_t i = 0; i < 16; i++)
+    representable565(&rgba[i * 4], 128, 128, 128, uint8_t(i * 17));
+  constexpr int32_t alphaRamp[4] = {0, 0, 0, 255 / 14 + 1};
+  roundTrip("BC3 alpha ramp", BlockFormat::BC3, rgba, alphaRamp);
+  uint8_t block[16];
+  uint8_t decoded[64];
+  encodeBlock(BlockFormat::BC3, rgba, block);
+  decodeBlock(BlockFormat::BC3, block, decoded);
+  check(decoded[3] == 0 && decoded[63] == 255,
+        std::format("BC3 alpha ramp: ends decode to {} and {}, not 0 and 255", decoded[3], decoded[63]));
+
+  // BC5 stores red and green on their own, so a checkerboard of the extremes is exact
+  constexpr int32_t exactRedGreen[4] = {0, 0, -1, -1};
+  for (uint32_t i = 0; i < 16; i++)
+  {
+    uint8_t value = (i + i / 4) % 2 ? 255 : 0;
+    rgba[i * 4] = value;
+    rgba[i * 4 + 1] = 255 - value;
+    rgba[i * 4 + 2] = 0;
+    rgba[i * 4 + 3] = 255;
+  }
+  roundTrip("BC5 extremes", BlockFormat::BC5, rgba, exactRedGreen);
+  for (uint32_t i = 0; i < 16; i++)
+  {
+    rgba[i * 4] = 255;
+    rgba[i * 4 + 1] = 0;
+  }
+  roundTrip("BC5 flat extremes", BlockFormat::BC5, rgba, exactRedGreen);
+}
+
+void checkKtx2()
+{
+  // an odd size, so the smaller levels have partial blocks
+  constexpr uint32_t width = 13;
+  constexpr uint32_t height = 7;
+  std::vector<std::vector<uint8_t>> levels;
+  for (uint32_t level = 0; std::max(width >> level, height >> level) > 0; level++)
+  {
+    uint32_t levelWidth = std::max(width >> level, 1u);
+    uint32_t levelHeight = std::max(height >> level, 1u);
+    std::vector<uint8_t> rgba(size_t(levelWidth) * levelHeight * 4);
+    for (size_t i = 0; i < rgba.size(); i++)
+      rgba[i] = uint8_t(i * 37 + level * 11);
+    levels.push_back(compressImage(BlockFormat::BC3, rgba.data(), levelWidth, levelHeight));
+  }
+
+  std::filesystem::path path = std::filesystem::temp_directory_path() / "texture_format_check.ktx2";
+  check(writeKtx2(path, Ktx2Format::BC3_SRGB, width, height, levels), std::format("cannot write {}", path.string()));
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  file.close();
+  std::filesystem::remove(path);
+
+  std::optional<Ktx2Image> image = parseKtx2(data);
+  check(image.has_value(), "KTX2: the written file does not parse");
+  if (image)
+  {
+    check(image->format == Ktx2Format::BC3_SRGB && image->width == width && image->height == height,
+          std::format("KTX2: read back as format {} at {}x{}", uint32_t(image->format), image->width, image->height));
+    check(image->levels.size() == levels.size(),
+          std::format("KTX2: read back {} levels, wrote {}", image->levels.size(), levels.size()));
+    for (size_t level = 0; level < std::min(image->levels.size(), levels.size()); level++)
+      check(std::equal(image->levels[level].begin(), image->levels[level].end(), levels[level].begin(),
+                       levels[level].end()),
+            std::format("KTX2: level {} differs from what was written", level));
+  }
+
+  for (size_t size = 0; size < data.size(); size++)
+    check(!parseKtx2(std::span(data.data(), size)), std::format("KTX2: accepted the file cut to {} bytes", size));
+  std::vector<uint8_t> corrupt = data;
+  corrupt[1] = 'X';
+  check(!parseKtx2(corrupt), "KTX2: accepted a file with the wrong identifier");
+}
+}
+
+int main()
+{
+  checkBlocks();
+  checkKtx2();
+  return checksPassed("Block compression and KTX2");
+}